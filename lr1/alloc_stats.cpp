@@ -0,0 +1,196 @@
+#include "alloc_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+static thread_local int currentPhase = ALLOC_OTHER;
+
+AllocScope::AllocScope(AllocPhase phase) : saved((AllocPhase)currentPhase) {
+    currentPhase = phase;
+}
+
+AllocScope::~AllocScope() {
+    currentPhase = saved;
+}
+
+void AllocScope::enter(AllocPhase phase) {
+    currentPhase = phase;
+}
+
+AllocPhase AllocScope::current() {
+    return (AllocPhase)currentPhase;
+}
+
+const char* AllocStats::phaseName(AllocPhase phase) {
+    static const char* const NAMES[ALLOC_PHASE_COUNT] = {
+        "other", "grammar", "first_follow", "states", "table",
+        "lex", "parse", "semantic", "optimize", "backend"
+    };
+    return NAMES[phase];
+}
+
+#ifdef LR1_ALLOC_STATS
+
+// 计数器都是平凡类型的静态对象，在任何分配发生之前就已初始化为零
+struct PhaseCounters {
+    atomic<long long> allocations;
+    atomic<long long> frees;
+    atomic<long long> bytes;
+    atomic<long long> liveBytes;
+    atomic<long long> peakBytes;
+};
+static PhaseCounters counters[ALLOC_PHASE_COUNT];
+static atomic<long long> totalLive;
+static atomic<long long> totalPeak;
+
+static void raisePeak(atomic<long long>& peak, long long value) {
+    long long old = peak.load(memory_order_relaxed);
+    while (value > old && !peak.compare_exchange_weak(old, value, memory_order_relaxed)) {}
+}
+
+// 每块前面放一个块头，记下原始指针、大小和分配时的阶段，释放时据此扣减
+struct BlockHeader {
+    void* raw;
+    size_t size;
+    int phase;
+};
+
+static void* allocateBlock(size_t size, size_t align) {
+    if (align < alignof(max_align_t)) align = alignof(max_align_t);
+    char* raw = (char*)malloc(size + align + sizeof(BlockHeader));
+    if (raw == nullptr) return nullptr;
+    uintptr_t p = ((uintptr_t)raw + sizeof(BlockHeader) + align - 1) & ~(uintptr_t)(align - 1);
+    BlockHeader* h = (BlockHeader*)p - 1;
+    h->raw = raw;
+    h->size = size;
+    h->phase = currentPhase;
+
+    PhaseCounters& c = counters[h->phase];
+    c.allocations.fetch_add(1, memory_order_relaxed);
+    c.bytes.fetch_add(size, memory_order_relaxed);
+    raisePeak(c.peakBytes, c.liveBytes.fetch_add(size, memory_order_relaxed) + size);
+    raisePeak(totalPeak, totalLive.fetch_add(size, memory_order_relaxed) + size);
+    return (void*)p;
+}
+
+static void freeBlock(void* p) {
+    if (p == nullptr) return;
+    BlockHeader* h = (BlockHeader*)p - 1;
+    PhaseCounters& c = counters[h->phase];
+    c.frees.fetch_add(1, memory_order_relaxed);
+    c.liveBytes.fetch_sub(h->size, memory_order_relaxed);
+    totalLive.fetch_sub(h->size, memory_order_relaxed);
+    free(h->raw);
+}
+
+static void* allocateOrThrow(size_t size, size_t align) {
+    void* p = allocateBlock(size, align);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return allocateOrThrow(size, 0); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocateBlock(size, 0); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocateBlock(size, 0); }
+void* operator new(size_t size, align_val_t align) { return allocateOrThrow(size, (size_t)align); }
+void* operator new[](size_t size, align_val_t align) { return allocateOrThrow(size, (size_t)align); }
+void* operator new(size_t size, align_val_t align, const nothrow_t&) noexcept { return allocateBlock(size, (size_t)align); }
+void* operator new[](size_t size, align_val_t align, const nothrow_t&) noexcept { return allocateBlock(size, (size_t)align); }
+
+void operator delete(void* p) noexcept { freeBlock(p); }
+void operator delete[](void* p) noexcept { freeBlock(p); }
+void operator delete(void* p, size_t) noexcept { freeBlock(p); }
+void operator delete[](void* p, size_t) noexcept { freeBlock(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { freeBlock(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { freeBlock(p); }
+void operator delete(void* p, align_val_t) noexcept { freeBlock(p); }
+void operator delete[](void* p, align_val_t) noexcept { freeBlock(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { freeBlock(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { freeBlock(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { freeBlock(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { freeBlock(p); }
+
+bool AllocStats::enabled() {
+    return true;
+}
+
+AllocPhaseStats AllocStats::phase(AllocPhase phase) {
+    const PhaseCounters& c = counters[phase];
+    AllocPhaseStats s;
+    s.allocations = c.allocations.load();
+    s.frees = c.frees.load();
+    s.bytes = c.bytes.load();
+    s.liveBytes = c.liveBytes.load();
+    s.peakBytes = c.peakBytes.load();
+    return s;
+}
+
+long long AllocStats::peakBytes() {
+    return totalPeak.load();
+}
+
+#else
+
+bool AllocStats::enabled() {
+    return false;
+}
+
+AllocPhaseStats AllocStats::phase(AllocPhase) {
+    AllocPhaseStats s = { 0, 0, 0, 0, 0 };
+    return s;
+}
+
+long long AllocStats::peakBytes() {
+    return 0;
+}
+
+#endif
+
+// 先取出全部计数再输出，输出本身的分配不影响报告的数字
+void AllocStats::report(ostream& out) {
+    AllocPhaseStats all[ALLOC_PHASE_COUNT];
+    long long totalCount = 0;
+    long long totalBytes = 0;
+    for (int p = 0; p < ALLOC_PHASE_COUNT; p++) {
+        all[p] = phase((AllocPhase)p);
+        totalCount += all[p].allocations;
+        totalBytes += all[p].bytes;
+    }
+    long long peak = peakBytes();
+
+    ostringstream text;
+    text << "\n==================== 堆分配统计 ====================\n";
+    text << left << setw(14) << "阶段" << right << setw(12) << "分配次数" << setw(12) << "释放次数"
+        << setw(14) << "分配字节" << setw(14) << "峰值占用" << setw(14) << "未释放" << setw(8) << "占比" << "\n";
+    text << fixed << setprecision(1);
+    for (int p = 0; p < ALLOC_PHASE_COUNT; p++) {
+        const AllocPhaseStats& s = all[p];
+        if (s.allocations == 0) continue;
+        text << left << setw(14) << phaseName((AllocPhase)p) << right << setw(12) << s.allocations
+            << setw(12) << s.frees << setw(14) << s.bytes << setw(14) << s.peakBytes << setw(14) << s.liveBytes
+            << setw(7) << (totalCount > 0 ? 100.0 * s.allocations / totalCount : 0) << "%\n";
+    }
+    text << "合计：分配 " << totalCount << " 次，" << totalBytes << " 字节，峰值占用 " << peak << " 字节\n";
+    out << text.str();
+}
+
+void AllocStats::writeJson(ostream& out) {
+    AllocPhaseStats all[ALLOC_PHASE_COUNT];
+    for (int p = 0; p < ALLOC_PHASE_COUNT; p++) all[p] = phase((AllocPhase)p);
+    long long peak = peakBytes();
+
+    ostringstream json;
+    json << "{\n  \"enabled\": " << (enabled() ? "true" : "false") << ",\n";
+    json << "  \"peak_bytes\": " << peak << ",\n";
+    json << "  \"phases\": {\n";
+    for (int p = 0; p < ALLOC_PHASE_COUNT; p++) {
+        const AllocPhaseStats& s = all[p];
+        json << "    \"" << phaseName((AllocPhase)p) << "\": {\"allocations\": " << s.allocations
+            << ", \"frees\": " << s.frees << ", \"bytes\": " << s.bytes << ", \"peak_bytes\": " << s.peakBytes
+            << ", \"live_bytes\": " << s.liveBytes << "}" << (p + 1 < ALLOC_PHASE_COUNT ? "," : "") << "\n";
+    }
+    json << "  }\n}\n";
+    out << json.str();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include "common.h"
+
+// ==================== 分阶段的堆分配统计 ====================
+// 以 LR1_ALLOC_STATS 编译（如 -DLR1_ALLOC_STATS）时替换全局的 operator new/delete，
+// 按当前线程所处的阶段记录分配次数、字节数和峰值占用。阶段由作用域宏标记，
+// 保存在thread_local变量中，线程池把调用者的阶段带到工作线程。
+// 不定义时宏展开为空，正常构建没有任何开销。
+// 注意只统计堆分配：从编译内存区（CompileArena）分配的对象不经过operator new
+enum AllocPhase {
+    ALLOC_OTHER,            // 未标记的代码（命令行解析、输出等）
+    ALLOC_GRAMMAR,          // 读入文法
+    ALLOC_FIRST_FOLLOW,     // FIRST/FOLLOW集
+    ALLOC_STATES,           // 构造项目集族
+    ALLOC_TABLE,            // 构造、加载或重排分析表
+    ALLOC_LEX,              // 词法分析
+    ALLOC_PARSE,            // 语法分析（不含语义动作）
+    ALLOC_SEMANTIC,         // 语义动作和语义记录
+    ALLOC_OPTIMIZE,         // 四元式优化
+    ALLOC_BACKEND,          // 字节码、本地代码、批量执行和目标文件
+    ALLOC_PHASE_COUNT
+};
+
+struct AllocPhaseStats {
+    long long allocations;  // 分配次数
+    long long frees;        // 释放次数（按分配时的阶段计）
+    long long bytes;        // 累计分配字节数
+    long long liveBytes;    // 当前仍未释放的字节数
+    long long peakBytes;    // 未释放字节数的峰值
+};
+
+// 进入作用域时切换当前线程的阶段，离开时恢复
+class AllocScope {
+private:
+    AllocPhase saved;
+
+public:
+    explicit AllocScope(AllocPhase phase);
+    ~AllocScope();
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+    void enter(AllocPhase phase);   // 在同一作用域内转入下一阶段
+    static AllocPhase current();
+};
+
+class AllocStats {
+public:
+    static bool enabled();          // 是否以 LR1_ALLOC_STATS 编译
+    static const char* phaseName(AllocPhase phase);
+    static AllocPhaseStats phase(AllocPhase phase);
+    static long long peakBytes();   // 全部阶段合计的峰值占用
+
+    static void report(ostream& out);
+    static void writeJson(ostream& out);
+};
+
+#ifdef LR1_ALLOC_STATS
+#define LR1_ALLOC_SCOPE(phase) AllocScope allocScope(phase)
+#define LR1_ALLOC_NEXT(phase) allocScope.enter(phase)
+#else
+#define LR1_ALLOC_SCOPE(phase) ((void)0)
+#define LR1_ALLOC_NEXT(phase) ((void)0)
+#endif
+
+#endif
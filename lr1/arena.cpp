@@ -0,0 +1,96 @@
+#include "arena.h"
+
+CompileArena::CompileArena(size_t initialBytes)
+    : largeIdle(0), buffer(new char[initialBytes]), bufferSize(initialBytes), minimumSize(initialBytes), used(0), regionUsed(0), overflows(0), upstream(this) {
+    region.emplace(buffer.get(), bufferSize, &upstream);
+}
+
+CompileArena::~CompileArena() {
+    for (const LargeBlock& b : largeBlocks) {
+        pmr::new_delete_resource()->deallocate(b.data, b.size, b.align);
+    }
+}
+
+void CompileArena::reset() {
+    region.reset();     // 溢出的块在这里归还全局分配器
+
+    // 块池只留上次编译用到的块，没用到的归还全局分配器
+    size_t n = 0;
+    for (LargeBlock& b : largeBlocks) {
+        if (b.inUse || b.touched) {
+            b.touched = false;
+            largeBlocks[n++] = b;
+        }
+        else {
+            largeIdle -= b.size;
+            pmr::new_delete_resource()->deallocate(b.data, b.size, b.align);
+        }
+    }
+    largeBlocks.resize(n);
+
+    // 对齐会浪费少量空间，多留一些余量
+    size_t wanted = min(max(regionUsed + regionUsed / 4, minimumSize), MAX_RETAINED);
+    if (wanted > bufferSize || wanted < bufferSize / 4) {
+        buffer.reset(new char[wanted]);
+        bufferSize = wanted;
+    }
+    region.emplace(buffer.get(), bufferSize, &upstream);
+    used = 0;
+    regionUsed = 0;
+    overflows = 0;
+}
+
+void* CompileArena::do_allocate(size_t bytes, size_t align) {
+    used += bytes;
+    if (bytes >= LARGE_BLOCK) {
+        // 取够用的最小空闲块；过大的块（超过两倍）留给更大的请求
+        LargeBlock* best = nullptr;
+        for (LargeBlock& b : largeBlocks) {
+            if (!b.inUse && b.size >= bytes && b.size <= bytes * 2 && b.align >= align
+                && (best == nullptr || b.size < best->size)) {
+                best = &b;
+            }
+        }
+        if (best == nullptr) {
+            overflows++;
+            size_t blockAlign = max(align, alignof(max_align_t));
+            largeBlocks.push_back({ pmr::new_delete_resource()->allocate(bytes, blockAlign), bytes, blockAlign, false, false });
+            best = &largeBlocks.back();
+        }
+        else {
+            largeIdle -= best->size;
+        }
+        best->inUse = true;
+        best->touched = true;
+        return best->data;
+    }
+    regionUsed += bytes;
+    return region->allocate(bytes, align);
+}
+
+// 分配与释放的大小相同，据此区分大块；大块回到块池，空闲块超过上限时直接归还
+void CompileArena::do_deallocate(void* p, size_t bytes, size_t) {
+    if (bytes < LARGE_BLOCK) return;
+    for (size_t i = 0; i < largeBlocks.size(); i++) {
+        LargeBlock& b = largeBlocks[i];
+        if (b.data != p) continue;
+        if (largeIdle + b.size > MAX_LARGE_IDLE) {
+            pmr::new_delete_resource()->deallocate(b.data, b.size, b.align);
+            largeBlocks.erase(largeBlocks.begin() + i);
+        }
+        else {
+            b.inUse = false;
+            largeIdle += b.size;
+        }
+        return;
+    }
+}
+
+void* CompileArena::Upstream::do_allocate(size_t bytes, size_t align) {
+    owner->overflows++;
+    return pmr::new_delete_resource()->allocate(bytes, align);
+}
+
+void CompileArena::Upstream::do_deallocate(void* p, size_t bytes, size_t align) {
+    pmr::new_delete_resource()->deallocate(p, bytes, align);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "common.h"
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// ==================== 单次编译的内存区 ====================
+// 一次编译的单词、四元式、分析栈等都从这里分配，小块释放时什么也不做，编译结束后整体丢弃。
+// 大块（单词表、四元式表等大容器的存储）放在单独的块池里：释放时回到池中，
+// 本次编译的其他容器和以后的编译可以再用，容器扩容丢下的旧块也不会滞留到编译结束。
+// 初始缓冲区按上次编译的小块用量调整，最多保留MAX_RETAINED；块池中空闲的块任何时候
+// 不超过MAX_LARGE_IDLE，多出的直接归还，编译之间只保留上次编译用到的块。
+// 偶发的大编译之后两者都会缩回，常规大小的反复编译不再向全局分配器申请
+class CompileArena : public pmr::memory_resource {
+private:
+    static constexpr size_t LARGE_BLOCK = 64 * 1024;                    // 不小于此的分配进入块池
+    static constexpr size_t MAX_RETAINED = 16 * 1024 * 1024;            // 两次编译之间最多保留的缓冲区
+    static constexpr size_t MAX_LARGE_IDLE = 32 * 1024 * 1024;          // 块池中空闲块的总量上限
+
+    struct LargeBlock {
+        void* data;
+        size_t size;
+        size_t align;
+        bool inUse;             // 正被容器使用
+        bool touched;           // 本次编译用到过
+    };
+    vector<LargeBlock> largeBlocks;     // 块数很少（几十个），线性查找即可
+    size_t largeIdle;                   // 空闲块的总字节数
+
+    unique_ptr<char[]> buffer;  // 初始缓冲区，不做初始化，只有用到的页才占用物理内存
+    size_t bufferSize;
+    size_t minimumSize;         // 构造时给定的大小，缩小时不低于它
+    optional<pmr::monotonic_buffer_resource> region;
+    size_t used;                // 本次编译已分配的字节数（含大块）
+    size_t regionUsed;          // 其中从region分配的字节数
+    int overflows;              // 本次编译超出初始缓冲区或块池、向全局分配器申请的次数
+
+    // 超出初始缓冲区时由region调用，用于计数
+    class Upstream : public pmr::memory_resource {
+    public:
+        CompileArena* owner;
+        explicit Upstream(CompileArena* o) : owner(o) {}
+    protected:
+        void* do_allocate(size_t bytes, size_t align) override;
+        void do_deallocate(void* p, size_t bytes, size_t align) override;
+        bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+    } upstream;
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void* p, size_t bytes, size_t align) override;
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    explicit CompileArena(size_t initialBytes = 64 * 1024);
+    ~CompileArena();
+    CompileArena(const CompileArena&) = delete;
+    CompileArena& operator=(const CompileArena&) = delete;
+
+    // 丢弃全部小块分配，O(1)；调用前所有使用本区的容器须已放弃其存储（大块随之回到块池）。
+    // 上次编译溢出时扩大初始缓冲区，用量远小于缓冲区时缩小，大小不超过MAX_RETAINED
+    void reset();
+
+    size_t bytesUsed() const { return used; }
+    size_t capacity() const { return bufferSize; }
+    int overflowCount() const { return overflows; }
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "batch.h"
+
+const int BatchEvaluator::BATCH_LANES;
+const int BatchEvaluator::TILE_GROUPS;
+
+bool BatchEvaluator::check(const ProgramView& p, string& error) {
+    if (p.count == 0 || p.ops[p.count - 1] != OP_HALT) {
+        error = "程序必须以halt结束";
+        return false;
+    }
+    for (int32_t i = 0; i < p.count; i++) {
+        uint8_t op = p.ops[i];
+        bool jump = op == OP_JMP || (op >= OP_JLT && op <= OP_BNE);
+        if (jump && (p.c[i] <= i || p.c[i] >= p.count)) {
+            error = "指令 " + to_string(i) + " 向后跳转，无法批量执行";
+            return false;
+        }
+        if (op >= OP_BLT && op <= OP_BNE && (p.d[i] <= i || p.d[i] >= p.count)) {
+            error = "指令 " + to_string(i) + " 向后跳转，无法批量执行";
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+const int L = BatchEvaluator::BATCH_LANES;
+
+// 掩码元素为0或-1（全1），按位选择，便于编译器向量化
+inline int64_t select(int64_t m, int64_t x, int64_t y) { return (x & m) | (y & ~m); }
+
+struct Add { static int64_t apply(int64_t x, int64_t y) { return (int64_t)((uint64_t)x + (uint64_t)y); } };
+struct Sub { static int64_t apply(int64_t x, int64_t y) { return (int64_t)((uint64_t)x - (uint64_t)y); } };
+struct Mul { static int64_t apply(int64_t x, int64_t y) { return (int64_t)((uint64_t)x * (uint64_t)y); } };
+
+struct Lt { static bool test(int64_t x, int64_t y) { return x < y; } };
+struct Le { static bool test(int64_t x, int64_t y) { return x <= y; } };
+struct Gt { static bool test(int64_t x, int64_t y) { return x > y; } };
+struct Ge { static bool test(int64_t x, int64_t y) { return x >= y; } };
+struct Eq { static bool test(int64_t x, int64_t y) { return x == y; } };
+struct Ne { static bool test(int64_t x, int64_t y) { return x != y; } };
+
+template <typename Op>
+void arith(int64_t* dst, const int64_t* a, const int64_t* b, const int64_t* m, int64_t* next) {
+    for (int k = 0; k < L; k++) {
+        dst[k] = select(m[k], Op::apply(a[k], b[k]), dst[k]);
+        next[k] |= m[k];
+    }
+}
+
+// 条件为真的记录流向taken，其余流向other
+template <typename Cmp>
+void branch(const int64_t* a, const int64_t* b, const int64_t* m, int64_t* taken, int64_t* other) {
+    for (int k = 0; k < L; k++) {
+        int64_t cond = -(int64_t)Cmp::test(a[k], b[k]);
+        taken[k] |= m[k] & cond;
+        other[k] |= m[k] & ~cond;
+    }
+}
+
+template <typename Cmp>
+void branchOp(bool fused, const int64_t* a, const int64_t* b, const int64_t* m,
+    int64_t* arrive, int32_t c, int32_t d, int32_t i) {
+    branch<Cmp>(a, b, m, arrive + (size_t)c * L, arrive + (size_t)(fused ? d : i + 1) * L);
+}
+
+// 执行一组记录。r为各槽位的列（slotCount*L），arrive为各指令的到达掩码（count*L，调用前清零），
+// err记录除零的记录；出错的记录不再到达后续指令，保留出错时的状态，与虚拟机一致
+void evalGroup(const ProgramView& p, int64_t* r, int64_t* arrive, int64_t* err) {
+    for (int32_t i = 0; i < p.count; i++) {
+        const int64_t* m = arrive + (size_t)i * L;
+
+        int64_t any = 0;
+        for (int k = 0; k < L; k++) any |= m[k];
+        if (any == 0) continue;
+
+        uint8_t op = p.ops[i];
+        const int64_t* a = r + (size_t)p.a[i] * L;
+        const int64_t* b = r + (size_t)p.b[i] * L;
+        int64_t* next = arrive + (size_t)(i + 1) * L;
+
+        switch (op) {
+        case OP_HALT:
+            break;
+        case OP_MOV: {
+            int64_t* dst = r + (size_t)p.c[i] * L;
+            for (int k = 0; k < L; k++) {
+                dst[k] = select(m[k], a[k], dst[k]);
+                next[k] |= m[k];
+            }
+            break;
+        }
+        case OP_ADD: arith<Add>(r + (size_t)p.c[i] * L, a, b, m, next); break;
+        case OP_SUB: arith<Sub>(r + (size_t)p.c[i] * L, a, b, m, next); break;
+        case OP_MUL: arith<Mul>(r + (size_t)p.c[i] * L, a, b, m, next); break;
+        case OP_DIV: {
+            int64_t* dst = r + (size_t)p.c[i] * L;
+            for (int k = 0; k < L; k++) {
+                int64_t bad = m[k] & -(int64_t)(b[k] == 0 || (b[k] == -1 && a[k] == INT64_MIN));
+                int64_t ok = m[k] & ~bad;
+                int64_t den = select(ok, b[k], 1);
+                dst[k] = select(ok, a[k] / den, dst[k]);
+                err[k] |= bad;
+                next[k] |= ok;
+            }
+            break;
+        }
+        case OP_JMP: {
+            int64_t* t = arrive + (size_t)p.c[i] * L;
+            for (int k = 0; k < L; k++) t[k] |= m[k];
+            break;
+        }
+        case OP_JLT: case OP_BLT: branchOp<Lt>(op == OP_BLT, a, b, m, arrive, p.c[i], p.d[i], i); break;
+        case OP_JLE: case OP_BLE: branchOp<Le>(op == OP_BLE, a, b, m, arrive, p.c[i], p.d[i], i); break;
+        case OP_JGT: case OP_BGT: branchOp<Gt>(op == OP_BGT, a, b, m, arrive, p.c[i], p.d[i], i); break;
+        case OP_JGE: case OP_BGE: branchOp<Ge>(op == OP_BGE, a, b, m, arrive, p.c[i], p.d[i], i); break;
+        case OP_JEQ: case OP_BEQ: branchOp<Eq>(op == OP_BEQ, a, b, m, arrive, p.c[i], p.d[i], i); break;
+        case OP_JNE: case OP_BNE: branchOp<Ne>(op == OP_BNE, a, b, m, arrive, p.c[i], p.d[i], i); break;
+        default:
+            break;
+        }
+    }
+}
+
+}
+
+void BatchEvaluator::run(const ProgramView& p, vector<vector<int64_t>>& columns,
+    vector<uint8_t>& status, ThreadPool& pool) {
+    size_t rows = columns.empty() ? 0 : columns[0].size();
+    status.assign(rows, VM_OK);
+    if (rows == 0) return;
+
+    size_t groups = (rows + L - 1) / L;
+    size_t tiles = (groups + TILE_GROUPS - 1) / TILE_GROUPS;
+
+    pool.parallelFor(tiles, [&](size_t tile) {
+        // 每个任务自带工作区，线程之间不共享可写数据
+        vector<int64_t> r((size_t)p.slotCount() * L);
+        vector<int64_t> arrive((size_t)p.count * L);
+        vector<int64_t> err(L);
+
+        for (int32_t k = 0; k < p.constCount; k++) {
+            fill_n(r.begin() + (size_t)(p.namedSlots + k) * L, L, p.constants[k]);
+        }
+
+        size_t firstGroup = tile * TILE_GROUPS;
+        size_t lastGroup = min(groups, firstGroup + TILE_GROUPS);
+        for (size_t g = firstGroup; g < lastGroup; g++) {
+            size_t row0 = g * L;
+            int n = (int)min((size_t)L, rows - row0);
+
+            for (int32_t s = 0; s < p.varSlots; s++) {
+                copy_n(columns[s].begin() + row0, n, r.begin() + (size_t)s * L);
+            }
+            fill(r.begin() + (size_t)p.varSlots * L, r.begin() + (size_t)p.namedSlots * L, 0);
+            fill(arrive.begin(), arrive.end(), 0);
+            fill(err.begin(), err.end(), 0);
+            fill_n(arrive.begin(), n, -1);     // 本组的有效记录从第一条指令开始
+
+            evalGroup(p, r.data(), arrive.data(), err.data());
+
+            for (int32_t s = 0; s < p.varSlots; s++) {
+                copy_n(r.begin() + (size_t)s * L, n, columns[s].begin() + row0);
+            }
+            for (int k = 0; k < n; k++) {
+                if (err[k]) status[row0 + k] = VM_DIV_ZERO;
+            }
+        }
+    });
+}
@@ -0,0 +1,27 @@
+#pragma once
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "common.h"
+#include "vm.h"
+#include "thread_pool.h"
+
+// ==================== 列式批量执行 ====================
+// 每个程序变量一列，一次处理BATCH_LANES条记录。
+// 跳转只向前，所以把控制流改写为谓词：每条指令有一个“到达掩码”，
+// 运算指令按掩码选择写入，条件分支把掩码拆分给两个目标，记录之间没有分支
+class BatchEvaluator {
+public:
+    static const int BATCH_LANES = 256;     // 每组记录数
+    static const int TILE_GROUPS = 16;      // 每个线程任务处理的组数
+
+    // 检查程序能否谓词化执行（跳转目标都在当前指令之后）
+    static bool check(const ProgramView& p, string& error);
+
+    // columns[s]为第s个程序变量的列（s < p.varSlots），行数相同，执行后原位存放结果；
+    // status[i]为第i条记录的VMStatus
+    static void run(const ProgramView& p, vector<vector<int64_t>>& columns,
+        vector<uint8_t>& status, ThreadPool& pool);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "compile_api.h"
+
+CompileLibrary::CompileLibrary() : parser(new LR1Parser()), ready(false) {
+    parser->setCacheDir("");
+    parser->setStreams(nullptr, nullptr);
+}
+
+bool CompileLibrary::init(string& error) {
+    ostringstream messages;
+    parser->setStreams(nullptr, messages.rdbuf());
+    ready = parser->init();
+    parser->setStreams(nullptr, nullptr);
+    if (!ready) {
+        error = messages.str();
+        while (!error.empty() && error.back() == '\n') error.pop_back();
+        if (error.empty()) error = "分析表构造失败";
+    }
+    return ready;
+}
+
+CompileResult CompileLibrary::compile(string_view source, const CompileOptions& options) const {
+    CompileSession session(*this);
+    return session.compile(source, options);
+}
+
+CompileSession::CompileSession(const CompileLibrary& lib) : library(lib), compiler(lib.parser.get()) {
+    compiler.setQuiet(true);
+    compiler.setErrorOutput(errors.rdbuf());
+}
+
+CompileResult CompileSession::compile(string_view source, const CompileOptions& options) {
+    errors.str("");
+    compiler.setOptimize(options.optimize);
+    compiler.setDirectParse(options.directParse);
+
+    CompileResult result;
+    if (!library.ready) {
+        result.diagnostics.push_back(Diagnostic(0, "分析表尚未构造"));
+        return result;
+    }
+    result.success = compiler.compile(source);
+    if (options.keepTokens) {
+        const TokenList& tokens = compiler.getTokens();
+        result.tokens.assign(tokens.begin(), tokens.end());
+    }
+    if (result.success) {
+        const QuadList& code = compiler.getCode();
+        result.code.assign(code.begin(), code.end());
+    }
+    result.diagnostics = compiler.getDiagnostics();
+    result.stats = compiler.getStats();
+
+    // 诊断以外的错误（如字节码生成失败）逐行记为第0行的诊断
+    istringstream lines(errors.str());
+    string line;
+    while (getline(lines, line)) {
+        if (!line.empty()) result.diagnostics.push_back(Diagnostic(0, line));
+    }
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef COMPILE_API_H
+#define COMPILE_API_H
+
+#include "common.h"
+#include "compiler.h"
+#include <memory>
+
+// ==================== 可重入的编译接口 ====================
+// 供嵌入其他程序使用：不读写标准输入输出，结果全部放在返回的CompileResult中。
+//   CompileLibrary  构造一次分析表，此后只读，可被任意多个线程同时使用
+//   CompileSession  每个线程一个，持有编译器和内存区，反复编译时复用
+// 两者都没有全局状态；同一个会话不能同时在两个线程中使用
+
+// 单次编译的选项
+struct CompileOptions {
+    bool optimize;      // 优化生成的四元式
+    bool keepTokens;    // 结果中带上单词序列
+    bool directParse;   // 允许使用直接编码的分析器
+
+    CompileOptions() : optimize(false), keepTokens(false), directParse(true) {}
+};
+
+// 单次编译的结果，不引用编译器内部的存储，会话再次编译后仍然有效
+struct CompileResult {
+    bool success;
+    vector<Token> tokens;           // 仅在keepTokens时填写，末尾为结束符#
+    vector<Quadruple> code;         // 成功时的四元式，首条地址为100
+    vector<Diagnostic> diagnostics; // 词法和语法错误；编译器内部错误的行号为0
+    CompileStats stats;
+
+    CompileResult() : success(false) {}
+};
+
+class CompileLibrary {
+private:
+    unique_ptr<LR1Parser> parser;   // 指针：const的compile仍可把它交给编译器只读共享
+    bool ready;
+
+public:
+    CompileLibrary();
+
+    // 构造前设置文法和缓存，默认为内置文法、不使用缓存
+    LR1Parser& getParser() { return *parser; }
+    // 构造分析表，不输出任何内容；失败时返回false，原因写入error
+    bool init(string& error);
+    bool isReady() const { return ready; }
+
+    // 用临时会话编译一次；频繁编译时应在各线程中使用自己的CompileSession
+    CompileResult compile(string_view source, const CompileOptions& options = CompileOptions()) const;
+
+    friend class CompileSession;
+};
+
+class CompileSession {
+private:
+    const CompileLibrary& library;
+    Compiler compiler;
+    ostringstream errors;   // 编译器内部错误，每次编译后转为诊断
+
+public:
+    // library须已init，且在会话销毁前保持有效
+    explicit CompileSession(const CompileLibrary& library);
+
+    CompileResult compile(string_view source, const CompileOptions& options = CompileOptions());
+};
+
+#endif
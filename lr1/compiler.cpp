@@ -1,386 +1,1019 @@
 #include "compiler.h"
+#include <random>
 
-Compiler::Compiler() {}
+// 由 lr1 --gen-direct 根据内置文法生成
+#include "direct_parser.inc"
 
-bool Compiler::compile(const string& source) {
-    cout << "\n========================================" << endl;
-    cout << "      IF-ELSE䷭" << endl;
-    cout << "      LR(1) + ַ" << endl;
-    cout << "========================================\n" << endl;
+Compiler::Compiler(LR1Parser* shared) : lexer(&arena), parser(shared != nullptr ? *shared : ownParser),
+    sharedParser(shared != nullptr), semantic(&arena), tokens(&arena), sink(&textSink), err(cerr.rdbuf()),
+    optimize(false), directParse(true), profile(nullptr), execute(false), runRepeat(1), nativeTarget(NATIVE_NONE),
+    batchRows(0), batchThreads(0), stateStack(&arena), symbolStack(&arena), semStack(&arena) {}
 
-    cout << "Դ" << source << endl << endl;
+void Compiler::setQuiet(bool on) {
+    sink->flush();
+    sink = on ? (OutputSink*)&nullSink : &textSink;
+    err.rdbuf(on ? nullptr : cerr.rdbuf());
+}
+
+void Compiler::setOutputFormat(OutputFormat format) {
+    sink->flush();
+    if (format == OUTPUT_TEXT) {
+        sink = &textSink;
+    }
+    else if (format == OUTPUT_NONE) {
+        sink = &nullSink;
+    }
+    else {
+        formatSink = OutputSink::create(format, stdout);
+        sink = formatSink.get();
+    }
+}
+
+void Compiler::setRunInput(const map<string, int64_t>& input, int repeat) {
+    execute = true;
+    runInput = input;
+    runRepeat = max(repeat, 1);
+}
+
+bool Compiler::compile(string_view source) {
+    stats.reset();
+    Stopwatch total;
+    resetArena();
+    bool ok = compilePhases(source);
+    sink->flush();
+    stats.success = ok;
+    stats.totalMs = total.elapsedMs();
+    stats.arenaBytes = arena.bytesUsed();
+    stats.arenaOverflows = arena.overflowCount();
+    return ok;
+}
+
+void Compiler::resetArena() {
+    tokens = TokenList(&arena);
+    stateStack = pmr::vector<int>(&arena);
+    symbolStack = pmr::vector<string>(&arena);
+    semStack = pmr::vector<SemanticRecord>(&arena);
+    semantic.reset();
+    arena.reset();
+}
 
-    // 1. ʷ
-    cout << ">>> ׶1ʷ" << endl;
+bool Compiler::compilePhases(string_view source) {
+    if (sink->enabled()) {
+        sink->message("\n========================================");
+        sink->message("      IF-ELSE条件语句翻译程序");
+        sink->message("      LR(1)方法 + 三地址码输出");
+        sink->message("========================================\n");
+
+        sink->message(string("源程序：").append(source));
+        sink->message("");
+    }
+
+    // 1. 词法分析
+    sink->message(">>> 阶段1：词法分析");
+    Stopwatch timer;
     lexer.setInput(source);
     tokens = lexer.tokenize();
+    stats.lexMs = timer.elapsedMs();
+    stats.tokens = tokens.size() - 1;
+
+    // 词法错误先记下，语法分析照常进行，以便一并报告
+    diagnostics = lexer.getDiagnostics();
+
+    sink->tokens(tokens);
+
+    // 2. 构造LR(1)分析表
+    sink->message(">>> 阶段2：构造LR(1)分析表");
+    timer.restart();
+    // 分析器构造时直接写到标准输出，先写出缓冲的内容以免顺序错乱
+    if (!sharedParser) sink->flush();
+    // 共享的分析表已由所有者构造好，这里只绑定语义动作
+    bool tableReady = (sharedParser || parser.init()) && bindSemanticActions();
+    stats.tableMs = timer.elapsedMs();
+    stats.table = parser.getStats();
+    sink->message("");
+    if (!tableReady) {
+        error() << "分析表构造失败！" << endl;
+        return false;
+    }
 
-    for (const Token& t : tokens) {
-        if (t.type == TOKEN_ERROR) {
-            cerr << "ʷ" << endl;
-            return false;
+    // 3. LR(1)语法分析 + 语义分析
+    sink->message(">>> 阶段3：LR(1)语法分析与语义翻译");
+    timer.restart();
+    bool parsed = lr1Parse();
+    stats.parseMs = timer.elapsedMs();
+    stats.quads = semantic.getCode().size();
+    stats.temps = semantic.getTempCount();
+    stats.cseHits = semantic.getCseHits();
+    stats.errors = diagnostics.size();
+    if (!diagnostics.empty()) {
+        printDiagnostics();
+        return false;
+    }
+    if (!parsed) {
+        error() << "语法分析出错！" << endl;
+        return false;
+    }
+
+    // 4. 输出结果
+    sink->message("\n>>> 阶段4：输出中间代码");
+    sink->code(semantic.getCode(), 100);
+
+    // 5. 中间代码优化（可选）
+    if (optimize) {
+        sink->message(">>> 阶段5：中间代码优化");
+        LR1_ALLOC_SCOPE(ALLOC_OPTIMIZE);
+        timer.restart();
+        QuadList code(semantic.getCode(), &arena);
+        Optimizer optimizer(code);
+        OptimizeStats opt = optimizer.run();
+        semantic.replaceCode(code);
+        stats.optimizeMs = timer.elapsedMs();
+        stats.optimized = true;
+        stats.optimizedQuads = code.size();
+
+        if (sink->enabled()) {
+            sink->message("常量折叠 " + to_string(opt.folded) + " 处，复制传播 " + to_string(opt.propagated)
+                + " 处，跳转链缩短 " + to_string(opt.threaded) + " 处，删除跳转 " + to_string(opt.jumpsRemoved) + " 条");
+            sink->message("删除不可达指令 " + to_string(opt.unreachable) + " 条，无用赋值 " + to_string(opt.deadStores) + " 条");
+            sink->message("四元式：" + to_string(stats.quads) + " 条 → " + to_string(stats.optimizedQuads) + " 条");
+            optimizer.printCFG(optimizer.buildCFG(), *sink);
+            sink->code(semantic.getCode(), 100);
         }
     }
 
-    lexer.printTokens(tokens);
+    // 6. 字节码执行（可选）
+    LR1_ALLOC_SCOPE(ALLOC_BACKEND);
+    if (execute || nativeTarget != NATIVE_NONE || batchRows > 0 || !objectPath.empty()) {
+        string error;
+        if (!Bytecode::lower(semantic.getCode(), bytecode, error)) {
+            this->error() << "字节码生成失败：" << error << endl;
+            return false;
+        }
+    }
+    if (execute) {
+        sink->message(">>> 阶段6：字节码执行");
+        if (!executeProgram()) return false;
+    }
 
-    // 2. LR(1)
-    cout << ">>> ׶2LR(1)" << endl;
-    parser.init();
-    cout << endl;
+    // 7. 本地代码（可选）
+    if (nativeTarget != NATIVE_NONE) {
+        sink->message(">>> 阶段7：生成本地代码");
+        if (!runNative()) return false;
+    }
 
-    // 3. LR(1)﷨ + 
-    cout << ">>> ׶3LR(1)﷨巭" << endl;
-    if (!lr1Parse()) {
-        cerr << "﷨" << endl;
-        return false;
+    // 8. 列式批量执行（可选）
+    if (batchRows > 0) {
+        sink->message(">>> 阶段8：列式批量执行");
+        if (!runBatch()) return false;
     }
 
-    // 4. 
-    cout << "\n>>> ׶4м" << endl;
-    semantic.printCode();
+    // 9. 输出目标文件（可选）
+    if (!objectPath.empty()) {
+        sink->message(">>> 阶段9：输出目标文件");
+        string error;
+        if (!ProgramImage::write(bytecode, objectPath, error)) {
+            this->error() << error << endl;
+            return false;
+        }
+        sink->message("已写入 " + objectPath + "（" + to_string(bytecode.ops.size()) + " 条指令）");
+    }
 
-    cout << "ɣ" << endl;
+    sink->message("编译完成！");
     return true;
 }
 
-// LR(1)﷨
+// LR(1)驱动的语法分析
 bool Compiler::lr1Parse() {
-    // ջ
-    while (!stateStack.empty()) stateStack.pop();
-    while (!symbolStack.empty()) symbolStack.pop();
-    while (!semStack.empty()) semStack.pop();
+    LR1_ALLOC_SCOPE(ALLOC_PARSE);
+    // 预先把每个单词转换为终结符编号
+    pmr::vector<int> termIds(&arena);
+    termIds.reserve(tokens.size());
+    for (const Token& t : tokens) {
+        termIds.push_back(parser.terminalId(tokenToSymbol(t)));
+    }
 
-    semantic.reset();
+    // 不需要输出分析过程时先用直接编码的分析器；出错时从头按表驱动分析，以便报告错误和恢复
+    if (directParse && profile == nullptr && !sink->enabled() && diagnostics.empty() && directParseAvailable()
+        && runDirectParse(termIds)) {
+        return true;
+    }
+
+    // 清空栈
+    stateStack.clear();
+    symbolStack.clear();
+    semStack.clear();
 
-    // ʼ
-    stateStack.push(0);
-    symbolStack.push("#");
+    semantic.reset();
+    if (!diagnostics.empty()) semantic.disableEmit();
 
-    SemanticRecord initRec;
-    semStack.push(initRec);
+    // 初始化
+    stateStack.push_back(0);
+    symbolStack.push_back("#");
+    semStack.push_back(SemanticRecord());
 
-    int ip = 0;  // ָ
+    int ip = 0;  // 输入指针
     int step = 0;
+    int lastErrorIp = -1;       // 上次出错的位置
+    int shifted = 3;            // 上次出错后移进的单词数
 
-    cout << "\nLR(1)̣" << endl;
-    cout << setw(6) << "" << setw(20) << "״̬ջ" << setw(25) << "ջ"
-        << setw(18) << "ǰ" << setw(12) << "" << endl;
-    cout << string(81, '-') << endl;
+    stats.shifts = 0;
+    stats.reductions.assign(parser.getProductionCount(), 0);
+    stats.maxStackDepth = 1;
+    if (profile != nullptr) profile->prepare(parser);
+
+    sink->traceHeader();
 
     while (true) {
         step++;
-        int s = stateStack.top();
-        string a = tokenToSymbol(tokens[ip]);
-
-        // ӡǰ״̬
-        // ״̬ջ
-        string stateStr = "";
-        stack<int> tempState = stateStack;
-        vector<int> stateVec;
-        while (!tempState.empty()) {
-            stateVec.push_back(tempState.top());
-            tempState.pop();
-        }
-        for (int i = stateVec.size() - 1; i >= 0; i--) {
-            stateStr += to_string(stateVec[i]) + " ";
-        }
+        int s = stateStack.back();
 
-        // ջ
-        string symbolStr = "";
-        stack<string> tempSymbol = symbolStack;
-        vector<string> symbolVec;
-        while (!tempSymbol.empty()) {
-            symbolVec.push_back(tempSymbol.top());
-            tempSymbol.pop();
-        }
-        for (int i = symbolVec.size() - 1; i >= 0; i--) {
-            symbolStr += symbolVec[i] + " ";
-        }
-
-        // ǰ
-        string inputStr = tokens[ip].value;
+        // 获取动作
+        int action = termIds[ip] >= 0 ? parser.actionAt(s, termIds[ip]) : ACTION_ERROR;
+        if (profile != nullptr && termIds[ip] >= 0) profile->countAction(s, termIds[ip]);
 
-        // ȡ
-        string action = parser.getAction(s, a);
-
-        cout << setw(6) << step
-            << setw(20) << stateStr.substr(0, 18)
-            << setw(25) << symbolStr.substr(0, 23)
-            << setw(18) << inputStr
-            << setw(12);
-
-        if (action.empty()) {
-            cout << "" << endl;
-            cerr << "\n﷨ڵ " << tokens[ip].line << " У'" << tokens[ip].value << "' " << endl;
-            return false;
+        // 输出当前状态（安静模式下跳过）
+        if (sink->enabled()) {
+            bool reduce = action < 0 && action != ACTION_ACCEPT;
+            sink->traceStep(step, stateStack, symbolStack, tokens[ip], action,
+                reduce ? &parser.getProduction(-action - 1) : nullptr);
         }
 
-        if (action[0] == 's') {
-            // ƽ
-            int nextState = stoi(action.substr(1));
-            cout << action << endl;
+        if (action == ACTION_ERROR) {
+            // 恢复后连续移进3个单词之前的错误多半是连带的，不再报告
+            if (shifted >= 3) reportSyntaxError(s, tokens[ip]);
+            semantic.disableEmit();
 
-            stateStack.push(nextState);
-            symbolStack.push(a);
+            // 在同一位置再次出错说明上次的同步点无效，至少丢弃一个单词
+            if (ip == lastErrorIp && shifted == 0 && tokens[ip].type != TOKEN_END) ip++;
+            lastErrorIp = ip;
+            shifted = 0;
 
-            // ¼
-            SemanticRecord rec;
-            if (tokens[ip].type == TOKEN_ID) {
-                rec.idName = tokens[ip].value;
-                rec.place = tokens[ip].value;
-            }
-            else if (tokens[ip].type == TOKEN_NUM) {
-                rec.numVal = tokens[ip].value;
-                rec.place = tokens[ip].value;
+            if (!recover(ip, termIds)) {
+                sink->message("无法从错误中恢复，停止分析");
+                return false;
             }
-            else if (tokens[ip].type >= TOKEN_LT && tokens[ip].type <= TOKEN_NE) {
-                rec.rop = tokens[ip].value;
+            continue;
+        }
+
+        if (action == ACTION_ACCEPT) {
+            if (!diagnostics.empty()) {
+                sink->message("\n语法分析结束，存在错误");
+                return false;
             }
-            semStack.push(rec);
+            sink->message("\n语法分析成功！");
+            return true;
+        }
+        else if (action > 0) {
+            // 移进
+            int nextState = action - 1;
+            stateStack.push_back(nextState);
+            symbolStack.push_back(tokenToSymbol(tokens[ip]));
+            stats.shifts++;
+            stats.maxStackDepth = max(stats.maxStackDepth, (int)stateStack.size());
+            pushToken(tokens[ip]);
 
             ip++;
+            shifted++;
         }
-        else if (action[0] == 'r') {
-            // Լ
-            int prodIndex = stoi(action.substr(1));
+        else {
+            // 归约
+            int prodIndex = -action - 1;
             const Production& prod = parser.getProduction(prodIndex);
 
-            cout << action << " (" << prod.left << "";
-            for (size_t i = 0; i < prod.right.size(); i++) {
-                cout << prod.right[i];
-                if (i < prod.right.size() - 1) cout << " ";
-            }
-            cout << ")" << endl;
-
-            //  || ״̬ͷ
+            // 弹出 |β| 个状态和符号
             int popCount = prod.len;
-            vector<SemanticRecord> poppedRecords;
-
-            for (int i = 0; i < popCount; i++) {
-                stateStack.pop();
-                symbolStack.pop();
-                poppedRecords.insert(poppedRecords.begin(), semStack.top());
-                semStack.pop();
+            stateStack.resize(stateStack.size() - popCount);
+            symbolStack.resize(symbolStack.size() - popCount);
+
+            // 执行语义动作（语义栈由动作自行在原位归约）
+            ReduceFn fn = reduceActions[prodIndex];
+            if (fn != nullptr) {
+                LR1_ALLOC_SCOPE(ALLOC_SEMANTIC);
+                fn(*this, popCount);
             }
 
-            // ִ嶯
-            executeSemanticAction(prodIndex, poppedRecords);
-
-            // ѹ󲿷
-            int topState = stateStack.top();
-            int gotoState = parser.getGoto(topState, prod.left);
+            // 压入左部符号；启用单产生式短路时按向前看一次转到链的末端，压入链末的左部
+            int topState = stateStack.back();
+            int lhs = parser.productionLhsId(prodIndex);
+            int gotoState = parser.gotoAt(topState, lhs);
+            if (profile != nullptr) profile->countGoto(topState, lhs);
 
             if (gotoState == -1) {
-                cerr << "\nGOTO״̬ " << topState << " " << prod.left << endl;
+                error() << "\nGOTO表错误！状态 " << topState << "，符号 " << prod.left << endl;
                 return false;
             }
 
-            stateStack.push(gotoState);
-            symbolStack.push(prod.left);
+            if (parser.hasUnitChains() && termIds[ip] >= 0) {
+                gotoState = parser.chainGotoAt(topState, lhs, termIds[ip]);
+                lhs = parser.accessingNonTerminal(gotoState);
+            }
+            stateStack.push_back(gotoState);
+            symbolStack.push_back(parser.nonTerminalName(lhs));
+            stats.reductions[prodIndex]++;
+            stats.maxStackDepth = max(stats.maxStackDepth, (int)stateStack.size());
         }
-        else if (action == "acc") {
-            cout << "acc" << endl;
-            cout << "\n﷨ɹ" << endl;
-            return true;
+    }
+
+    return false;
+}
+
+// 创建移进单词的语义记录
+void Compiler::pushToken(const Token& tok) {
+    LR1_ALLOC_SCOPE(ALLOC_SEMANTIC);
+    semStack.push_back(SemanticRecord());
+    SemanticRecord& rec = semStack.back();
+    if (tok.type == TOKEN_ID) {
+        rec.idName = tok.value;
+        rec.place = tok.value;
+    }
+    else if (tok.type == TOKEN_NUM) {
+        rec.numVal = tok.value;
+        rec.place = tok.value;
+    }
+    else if (tok.type >= TOKEN_LT && tok.type <= TOKEN_NE) {
+        rec.rop = tok.value;
+    }
+}
+
+// ==================== 直接编码分析 ====================
+
+struct Compiler::DirectActions {
+    Compiler& c;
+
+    void shift(int ip) {
+        c.pushToken(c.tokens[ip]);
+        c.stats.shifts++;
+        c.stats.maxStackDepth = max(c.stats.maxStackDepth, (int)c.stateStack.size());
+    }
+
+    // 调用时右部的状态已弹出，随后的GOTO再压入一个状态
+    void reduce(int prod, int len) {
+        LR1_ALLOC_SCOPE(ALLOC_SEMANTIC);
+        ReduceFn fn = c.reduceActions[prod];
+        if (fn != nullptr) fn(c, len);
+        c.stats.reductions[prod]++;
+        c.stats.maxStackDepth = max(c.stats.maxStackDepth, (int)c.stateStack.size() + 1);
+    }
+};
+
+bool Compiler::directParseAvailable() const {
+    return parser.getLayoutHash() == LR1_DIRECT_GRAMMAR;
+}
+
+// 只维护状态栈和语义栈，不记录符号栈
+bool Compiler::runDirectParse(const pmr::vector<int>& termIds) {
+    semStack.clear();
+    semantic.reset();
+    semStack.push_back(SemanticRecord());
+
+    stats.shifts = 0;
+    stats.reductions.assign(parser.getProductionCount(), 0);
+    stats.maxStackDepth = 1;
+
+    DirectActions act = { *this };
+    int ip = 0;
+    return lr1DirectParse(termIds.data(), ip, stateStack, act);
+}
+
+// 只识别不翻译的回调：基准中用来单独衡量分析器本身
+struct RecognizeActions {
+    long long steps;
+    void shift(int) { steps++; }
+    void reduce(int, int) { steps++; }
+};
+
+// 表驱动的识别，与lr1Parse的主循环相同但不做语义动作，返回移进和归约的步数，出错时返回-1
+static long long tableRecognize(const LR1Parser& parser, const int* terms, pmr::vector<int>& stack) {
+    long long steps = 0;
+    int ip = 0;
+    stack.clear();
+    stack.push_back(0);
+    while (true) {
+        int action = terms[ip] >= 0 ? parser.actionAt(stack.back(), terms[ip]) : ACTION_ERROR;
+        if (action == ACTION_ERROR) return -1;
+        if (action == ACTION_ACCEPT) return steps;
+        steps++;
+        if (action > 0) {
+            stack.push_back(action - 1);
+            ip++;
+        }
+        else {
+            int prod = -action - 1;
+            stack.resize(stack.size() - parser.getProduction(prod).len);
+            int lhs = parser.productionLhsId(prod);
+            stack.push_back(parser.hasUnitChains() ? parser.chainGotoAt(stack.back(), lhs, terms[ip])
+                : parser.gotoAt(stack.back(), lhs));
         }
+    }
+}
 
-        // ֹѭ
-        if (step > 500) {
-            cerr << "\nܴ࣬ڴ" << endl;
-            return false;
+bool Compiler::benchmarkParse(int repeat) {
+    if (!stats.success) return false;
+    // 分析表重排或文法不同时生成的分析器不可用，只测表驱动分析
+    bool direct = directParseAvailable();
+
+    // 单词序列复制到内存区之外，每轮分析前整体释放内存区，避免重复分析占用越来越多的内存
+    TokenList input(tokens, pmr::new_delete_resource());
+    OutputSink* saved = sink;
+    bool savedDirect = directParse;
+    sink = &nullSink;
+
+    // 0、1：分析并翻译；2、3：只识别
+    double ms[4] = { 0, 0, 0, 0 };
+    vector<Quadruple> code[2];
+    bool ok = true;
+    for (int mode = 0; mode < (direct ? 2 : 1) && ok; mode++) {
+        directParse = mode == 1;
+        for (int i = 0; i < repeat && ok; i++) {
+            resetArena();
+            tokens = TokenList(input, &arena);
+            Stopwatch timer;
+            ok = lr1Parse();
+            ms[mode] += timer.elapsedMs();
         }
+        code[mode].assign(semantic.getCode().begin(), semantic.getCode().end());
     }
 
-    return false;
+    sink = saved;
+    directParse = savedDirect;
+    if (!ok) {
+        error() << "重复分析时出错" << endl;
+        return false;
+    }
+
+    pmr::vector<int> termIds(pmr::new_delete_resource());
+    for (const Token& t : input) termIds.push_back(parser.terminalId(tokenToSymbol(t)));
+    pmr::vector<int> stack(pmr::new_delete_resource());
+    long long steps[2] = { 0, 0 };
+    Stopwatch timer;
+    for (int i = 0; i < repeat; i++) steps[0] = tableRecognize(parser, termIds.data(), stack);
+    ms[2] = timer.elapsedMs();
+    timer.restart();
+    for (int i = 0; direct && i < repeat; i++) {
+        RecognizeActions act = { 0 };
+        int ip = 0;
+        lr1DirectParse(termIds.data(), ip, stack, act);
+        steps[1] = act.steps;
+    }
+    ms[3] = timer.elapsedMs();
+
+    size_t count = input.size();
+    ostringstream report;
+    report << fixed << setprecision(3);
+    report << "\n分析器基准：单词数 " << count << "，分析步数 " << steps[0] << "，重复 " << repeat << " 次\n";
+    const char* names[4] = { "表驱动分析+翻译", "直接编码分析+翻译", "表驱动分析（仅识别）", "直接编码分析（仅识别）" };
+    for (int mode = 0; mode < 4; mode++) {
+        if (!direct && mode % 2 == 1) continue;
+        double per = ms[mode] / repeat;
+        report << names[mode] << "：每次 " << per << " ms，" << (long long)(per > 0 ? count / (per / 1000.0) : 0)
+            << " 单词/秒\n";
+    }
+    if (!direct) {
+        report << "direct_parser.inc 与当前分析表（" << parser.getLayoutHash() << "）不一致，未测直接编码分析\n";
+        sink->flush();
+        cout << report.str() << endl;
+        return true;
+    }
+    report << setprecision(2) << "加速比：分析+翻译 " << (ms[1] > 0 ? ms[0] / ms[1] : 0)
+        << "，仅识别 " << (ms[3] > 0 ? ms[2] / ms[3] : 0);
+
+    bool same = code[0].size() == code[1].size() && steps[0] == steps[1];
+    for (size_t i = 0; same && i < code[0].size(); i++) {
+        const Quadruple& x = code[0][i];
+        const Quadruple& y = code[1][i];
+        same = x.op == y.op && x.arg1 == y.arg1 && x.arg2 == y.arg2 && x.result == y.result;
+    }
+    if (!same) {
+        error() << "两种分析器的结果不一致" << endl;
+        return false;
+    }
+    report << "\n两种分析器的分析步数和生成的四元式一致\n";
+
+    // 基准结果是专门要求的输出，不受输出格式影响
+    sink->flush();
+    cout << report.str() << endl;
+    return true;
 }
 
-// ִ嶯
-void Compiler::executeSemanticAction(int prodIndex, vector<SemanticRecord>& rec) {
-    SemanticRecord newRec;
+bool Compiler::benchmarkLex(string_view source, int repeat, int maxThreads) {
+    if (maxThreads <= 0) maxThreads = max((int)thread::hardware_concurrency(), 1);
+    vector<int> counts;
+    for (int t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+    counts.push_back(maxThreads);
+
+    ostringstream report;
+    report << fixed << setprecision(3);
+    report << "\n词法分析基准：源码 " << source.size() << " 字节，重复 " << repeat << " 次\n";
+
+    TokenList reference(pmr::new_delete_resource());
+    vector<Diagnostic> referenceDiagnostics;
+    double baseMs = 0;
+    for (int t : counts) {
+        Lexer lx(pmr::new_delete_resource());
+        lx.setThreads(t);
+        lx.setInput(source);
+        TokenList result(pmr::new_delete_resource());
+        Stopwatch timer;
+        for (int i = 0; i < repeat; i++) result = lx.tokenize();
+        double per = timer.elapsedMs() / repeat;
+
+        if (t == 1) {
+            reference = move(result);
+            referenceDiagnostics = lx.getDiagnostics();
+            baseMs = per;
+        }
+        else {
+            // 逐个单词核对，包括行号和词法错误
+            bool same = result.size() == reference.size() && lx.getDiagnostics().size() == referenceDiagnostics.size();
+            for (size_t i = 0; same && i < result.size(); i++) {
+                same = result[i].type == reference[i].type && result[i].value == reference[i].value &&
+                    result[i].line == reference[i].line;
+            }
+            for (size_t i = 0; same && i < referenceDiagnostics.size(); i++) {
+                same = lx.getDiagnostics()[i].line == referenceDiagnostics[i].line &&
+                    lx.getDiagnostics()[i].message == referenceDiagnostics[i].message;
+            }
+            if (!same) {
+                error() << t << " 个线程分块分析的结果与顺序分析不一致" << endl;
+                return false;
+            }
+        }
 
-    switch (prodIndex) {
-    case 0: {
-        // S'  S
-        // Ҫ⴦
-        if (!rec.empty()) newRec = rec[0];
-        break;
+        report << setw(3) << t << " 线程（" << lx.getChunks() << " 块）：每次 " << per << " ms，"
+            << setprecision(1) << (per > 0 ? source.size() / (per / 1000.0) / 1e6 : 0) << " MB/s，"
+            << (long long)(per > 0 ? reference.size() / (per / 1000.0) : 0) << " 单词/秒，加速比 "
+            << setprecision(2) << (per > 0 ? baseMs / per : 0) << setprecision(3) << "\n";
     }
+    report << "各线程数的单词序列（含行号）和词法错误与顺序分析一致\n";
 
-    case 1: {
-        // S  id = E
-        // rec[0]=id, rec[1]='=', rec[2]=E
-        string id = rec[0].idName;
-        string place = rec[2].place;
-        semantic.emit("=", place, "_", id);
-        newRec.nextList = -1;
-        break;
+    sink->flush();
+    cout << report.str() << endl;
+    return true;
+}
+
+// 记录一条语法错误，列出当前状态下可以接受的单词
+void Compiler::reportSyntaxError(int state, const Token& tok) {
+    // 按文法中的终结符顺序列出，与分析表是否重排无关
+    vector<int> accepted;
+    for (int t = 0; t < parser.terminalCount(); t++) {
+        if (parser.actionAt(state, t) != ACTION_ERROR) accepted.push_back(t);
     }
+    sort(accepted.begin(), accepted.end(),
+        [this](int x, int y) { return parser.originalTerminal(x) < parser.originalTerminal(y); });
+
+    string expected;
+    int count = 0;
+    for (int t : accepted) {
+        const string& name = parser.terminalName(t);
+        if (count++ > 0) expected += " ";
+        expected += name == "#" ? "输入结束" : "'" + name + "'";
+    }
+
+    string near = tok.type == TOKEN_END ? "输入结束处" : "'" + tok.value + "' 附近";
+    string message = "语法错误：" + near;
+    if (count > 0) message += "，期望 " + expected;
+    diagnostics.push_back(Diagnostic(tok.line, message));
+}
 
-    case 2: {
-        // S  if ( C ) M { L } N
-        int C_true = rec[2].trueList;
-        int C_false = rec[2].falseList;
-        int M_quad = rec[4].quad;
+// 应急模式恢复：丢弃单词直到同步单词（语句开始、'}'、'#'），再从栈顶向下弹出状态。
+// 语句开始的单词只在能开始一条语句的状态恢复（避免被当作表达式的一部分）；
+// '}'和'#'在能直接接受它，或者把已经分析的部分当作一条完整语句后能接受它的状态恢复。
+// 成功时ip指向同步单词，三个栈已调整好；到达输入末尾仍无法恢复时返回false
+bool Compiler::recover(int& ip, const pmr::vector<int>& termIds) {
+    // 语句的非终结符：增广产生式 S' → S 的右部
+    const Production& start = parser.getProduction(0);
+    int stmt = start.right.empty() ? -1 : parser.nonTerminalId(start.right[0]);
+
+    vector<bool> starts(parser.terminalCount(), false), closes(parser.terminalCount(), false);
+    for (int t = 0; t < parser.terminalCount(); t++) {
+        const string& name = parser.terminalName(t);
+        starts[t] = parser.actionAt(0, t) > 0;
+        closes[t] = name == "}" || name == "#";
+    }
 
-        // ڼif䣨elseNɵgotoģɾ
-        semantic.removeLastQuad();
+    for (; ip < (int)tokens.size(); ip++) {
+        int t = termIds[ip];
+        if (t < 0 || (!starts[t] && !closes[t])) continue;
 
-        // C.trueM.quadthen֧ʼ
-        semantic.backpatch(C_true, M_quad);
-        // C.falsethen֧֮
-        semantic.backpatch(C_false, semantic.getNextQuad());
+        for (int depth = stateStack.size() - 1; depth >= 0; depth--) {
+            int s = stateStack[depth];
+            bool accepts = parser.actionAt(s, t) != ACTION_ERROR;
+            int g = stmt >= 0 ? parser.gotoAt(s, stmt) : -1;
+            if (starts[t]) {
+                if (!accepts || g < 0) continue;
+            }
+            else if (accepts) {
+                g = -1;
+            }
+            else if (g < 0 || parser.actionAt(g, t) == ACTION_ERROR) {
+                continue;
+            }
 
-        newRec.nextList = -1;
-        break;
+            stateStack.resize(depth + 1);
+            symbolStack.resize(depth + 1);
+            semStack.resize(depth + 1);
+            if (!starts[t] && !accepts) {
+                stateStack.push_back(g);
+                symbolStack.push_back(start.right[0]);
+                semStack.push_back(SemanticRecord());
+            }
+            if (sink->enabled()) {
+                sink->message("       恢复：在 '" + tokens[ip].value + "' 处继续，栈顶状态 " + to_string(stateStack.back()));
+            }
+            return true;
+        }
+        if (tokens[ip].type == TOKEN_END) break;
     }
+    return false;
+}
+
+void Compiler::printDiagnostics() {
+    stable_sort(diagnostics.begin(), diagnostics.end(),
+        [](const Diagnostic& x, const Diagnostic& y) { return x.line < y.line; });
 
-    case 3: {
-        // S  if ( C ) M { L } N else M { L }
-        // rec: 0=if, 1=(, 2=C, 3=), 4=M1, 5={, 6=L1, 7=}, 8=N, 9=else, 10=M2, 11={, 12=L2, 13=}
-        int C_true = rec[2].trueList;
-        int C_false = rec[2].falseList;
-        int M1_quad = rec[4].quad;
-        int M2_quad = rec[10].quad;
-        int N_quad = rec[8].quad;
+    sink->diagnostics(diagnostics);
+}
 
-        // C.trueM1.quadthen֧ʼ
-        semantic.backpatch(C_true, M1_quad);
-        // C.falseM2.quadelse֧ʼ
-        semantic.backpatch(C_false, M2_quad);
-        // N
-        semantic.backpatch(N_quad, semantic.getNextQuad());
+// 按产生式标签绑定语义动作，右部长度须与动作一致
+bool Compiler::bindSemanticActions() {
+    // fn为nullptr的动作（F→id、F→num）语义值已在移进时填好，无需处理
+    static const struct {
+        const char* label;
+        int len;
+        ReduceFn fn;
+    } LABELS[] = {
+        { "assign",  3,  &Compiler::reduce<3, &Compiler::actAssign> },
+        { "if",      9,  &Compiler::reduce<9, &Compiler::actIf> },
+        { "if_else", 14, &Compiler::reduce<14, &Compiler::actIfElse> },
+        { "seq",     3,  &Compiler::reduce<3, &Compiler::actSeq> },
+        { "cond",    3,  &Compiler::reduce<3, &Compiler::actCond> },
+        { "mark",    0,  &Compiler::reduce<0, &Compiler::actMark> },
+        { "jump",    0,  &Compiler::reduce<0, &Compiler::actJump> },
+        { "add",     3,  &Compiler::reduce<3, &Compiler::actAdd> },
+        { "sub",     3,  &Compiler::reduce<3, &Compiler::actSub> },
+        { "mul",     3,  &Compiler::reduce<3, &Compiler::actMul> },
+        { "div",     3,  &Compiler::reduce<3, &Compiler::actDiv> },
+        { "paren",   3,  &Compiler::reduce<3, &Compiler::actParen> },
+        { "id",      1,  nullptr },
+        { "num",     1,  nullptr },
+    };
+
+    reduceActions.assign(parser.getProductionCount(), nullptr);
+
+    for (int i = 0; i < parser.getProductionCount(); i++) {
+        const Production& prod = parser.getProduction(i);
+
+        // 无标签：传递右部第一个符号的语义值，单产生式什么也不用做
+        if (prod.label.empty()) {
+            if (prod.len != 1) reduceActions[i] = &Compiler::reducePass;
+            continue;
+        }
 
-        newRec.nextList = -1;
-        break;
+        bool found = false;
+        for (const auto& entry : LABELS) {
+            if (prod.label != entry.label) continue;
+            if (prod.len != entry.len) {
+                error() << "语义动作 @" << prod.label << " 要求右部有 " << entry.len << " 个符号（产生式 "
+                    << parser.productionToString(i) << "）" << endl;
+                return false;
+            }
+            reduceActions[i] = entry.fn;
+            found = true;
+            break;
+        }
+        if (!found) {
+            error() << "未知的语义动作标签 @" << prod.label << "（产生式 " << parser.productionToString(i) << "）" << endl;
+            return false;
+        }
     }
+    return true;
+}
 
-    case 4: {
-        // L  L M S
-        // rec: 0=L, 1=M, 2=S
-        newRec.nextList = rec[2].nextList;
-        break;
+template <int Len, void (*Action)(Compiler&, SemanticRecord*)>
+void Compiler::reduce(Compiler& c, int) {
+    pmr::vector<SemanticRecord>& st = c.semStack;
+    if (Len == 0) {
+        st.push_back(SemanticRecord());
+        Action(c, &st.back());
+    }
+    else {
+        Action(c, &st[st.size() - Len]);
+        st.resize(st.size() - (Len - 1));
     }
+}
 
-    case 5: {
-        // L  S
-        if (!rec.empty()) newRec = rec[0];
-        break;
+// 无标签且右部长度不为1的产生式：保留右部第一个符号的语义值
+void Compiler::reducePass(Compiler& c, int len) {
+    pmr::vector<SemanticRecord>& st = c.semStack;
+    if (len == 0) {
+        st.push_back(SemanticRecord());
+    }
+    else {
+        st.resize(st.size() - (len - 1));
     }
+}
 
-    case 6: {
-        // C  E rop E
-        // rec: 0=E1, 1=rop, 2=E2
-        string E1_place = rec[0].place;
-        string rop = rec[1].rop;
-        string E2_place = rec[2].place;
+// ==================== 语义动作 ====================
 
-        newRec.trueList = semantic.getNextQuad();
-        semantic.emit("j" + rop, E1_place, E2_place, "0");
+void Compiler::actAssign(Compiler& c, SemanticRecord* rhs) {
+    // S → id = E
+    // rhs[0]=id, rhs[1]='=', rhs[2]=E
+    c.semantic.emit("=", rhs[2].place, "_", rhs[0].idName);
+    c.semantic.freetemp(rhs[2].place);
+    rhs[0].nextList = -1;
+}
 
-        newRec.falseList = semantic.getNextQuad();
-        semantic.emit("j", "_", "_", "0");
-        break;
-    }
+void Compiler::actIf(Compiler& c, SemanticRecord* rhs) {
+    // S → if ( C ) M { L } N
+    // rhs: 0=if, 1=(, 2=C, 3=), 4=M, 5={, 6=L, 7=}, 8=N
+    int C_true = rhs[2].trueList;
+    int C_false = rhs[2].falseList;
+    int M_quad = rhs[4].quad;
+
+    // 对于简单if语句（无else），N生成的goto是冗余的，删除它
+    c.semantic.removeLastQuad();
+
+    // 回填C.true到M.quad（then分支起始）
+    c.semantic.backpatch(C_true, M_quad);
+    // C.false跳到语句结束（then分支之后）
+    c.semantic.backpatch(C_false, c.semantic.getNextQuad());
+    c.semantic.popScope();
+
+    rhs[0].nextList = -1;
+}
 
-    case 7: {
-        // M  
-        newRec.quad = semantic.getNextQuad();
-        break;
+void Compiler::actIfElse(Compiler& c, SemanticRecord* rhs) {
+    // S → if ( C ) M { L } N else M { L }
+    // rhs: 0=if, 1=(, 2=C, 3=), 4=M1, 5={, 6=L1, 7=}, 8=N, 9=else, 10=M2, 11={, 12=L2, 13=}
+    int C_true = rhs[2].trueList;
+    int C_false = rhs[2].falseList;
+    int M1_quad = rhs[4].quad;
+    int M2_quad = rhs[10].quad;
+    int N_quad = rhs[8].quad;
+
+    // 回填C.true到M1.quad（then分支起始）
+    c.semantic.backpatch(C_true, M1_quad);
+    // 回填C.false到M2.quad（else分支起始）
+    c.semantic.backpatch(C_false, M2_quad);
+    // N跳过else分支
+    c.semantic.backpatch(N_quad, c.semantic.getNextQuad());
+    c.semantic.popScope();
+
+    rhs[0].nextList = -1;
+}
+
+void Compiler::actSeq(Compiler&, SemanticRecord* rhs) {
+    // L → L M S
+    // rhs: 0=L, 1=M, 2=S
+    rhs[0].nextList = rhs[2].nextList;
+}
+
+void Compiler::actCond(Compiler& c, SemanticRecord* rhs) {
+    // C → E rop E
+    // rhs: 0=E1, 1=rop, 2=E2
+    int trueList = c.semantic.getNextQuad();
+    c.semantic.emit("j" + rhs[1].rop, rhs[0].place, rhs[2].place, "0");
+    c.semantic.freetemp(rhs[2].place);
+    c.semantic.freetemp(rhs[0].place);
+
+    int falseList = c.semantic.getNextQuad();
+    c.semantic.emit("j", "_", "_", "0");
+
+    rhs[0].trueList = trueList;
+    rhs[0].falseList = falseList;
+
+    // 接下来是then分支，它只能从条件的真出口进入
+    c.semantic.pushScope();
+}
+
+void Compiler::actMark(Compiler& c, SemanticRecord* rhs) {
+    // M → ε
+    rhs->quad = c.semantic.getNextQuad();
+}
+
+void Compiler::actJump(Compiler& c, SemanticRecord* rhs) {
+    // N → ε
+    rhs->quad = c.semantic.getNextQuad();
+    c.semantic.emit("j", "_", "_", "0");
+
+    // then分支结束；else分支（或语句结束）只能从条件的假出口进入
+    c.semantic.popScope();
+    c.semantic.pushScope();
+}
+
+void Compiler::actAdd(Compiler& c, SemanticRecord* rhs) {
+    // E → E + T
+    // rhs: 0=E1, 1='+', 2=T
+    rhs[0].place = c.semantic.emitExpr("+", rhs[0].place, rhs[2].place);
+}
+
+void Compiler::actSub(Compiler& c, SemanticRecord* rhs) {
+    // E → E - T
+    rhs[0].place = c.semantic.emitExpr("-", rhs[0].place, rhs[2].place);
+}
+
+void Compiler::actMul(Compiler& c, SemanticRecord* rhs) {
+    // T → T * F
+    rhs[0].place = c.semantic.emitExpr("*", rhs[0].place, rhs[2].place);
+}
+
+void Compiler::actDiv(Compiler& c, SemanticRecord* rhs) {
+    // T → T / F
+    rhs[0].place = c.semantic.emitExpr("/", rhs[0].place, rhs[2].place);
+}
+
+void Compiler::actParen(Compiler&, SemanticRecord* rhs) {
+    // F → ( E )
+    // rhs: 0='(', 1=E, 2=')'
+    rhs[0].place = rhs[1].place;
+}
+
+void Compiler::printStatsJson(ostream& out) {
+    vector<string> ruleNames;
+    for (int i = 0; i < parser.getProductionCount(); i++) {
+        ruleNames.push_back(parser.productionToString(i));
     }
+    writeStatsJson(out, stats, ruleNames);
+}
 
-    case 8: {
-        // N  
-        newRec.quad = semantic.getNextQuad();
-        semantic.emit("j", "_", "_", "0");
-        break;
+// 把四元式翻译为字节码并以runInput为输入执行
+bool Compiler::executeProgram() {
+    const Bytecode& bc = bytecode;
+    if (sink->enabled()) {
+        ostringstream listing;
+        bc.disassemble(listing);
+        string text = listing.str();
+        if (!text.empty() && text.back() == '\n') text.pop_back();
+        sink->message(text);
     }
 
-    case 9: {
-        // E  E + T
-        // rec: 0=E1, 1='+', 2=T
-        string E1_place = rec[0].place;
-        string T_place = rec[2].place;
-        newRec.place = semantic.newtemp();
-        semantic.emit("+", E1_place, T_place, newRec.place);
-        break;
+    ProgramView view = bc.view();
+    Stopwatch timer;
+    VMStatus status = VM::run(view, bc.names, runInput, runOutput);
+
+    // 重复执行时只计执行本身，输入预先装入寄存器
+    if (status == VM_OK && runRepeat > 1) {
+        vector<int64_t> init(view.slotCount(), 0);
+        for (int i = 0; i < view.varSlots; i++) {
+            auto it = runInput.find(bc.names[i]);
+            if (it != runInput.end()) init[i] = it->second;
+        }
+        vector<int64_t> regs(init.size());
+        timer.restart();
+        for (int i = 0; i < runRepeat; i++) {
+            copy(init.begin(), init.end(), regs.begin());
+            VM::execute(view, regs.data());
+        }
     }
+    stats.executeMs = timer.elapsedMs();
+    stats.executeRuns = runRepeat;
 
-    case 10: {
-        // E  E - T
-        string E1_place = rec[0].place;
-        string T_place = rec[2].place;
-        newRec.place = semantic.newtemp();
-        semantic.emit("-", E1_place, T_place, newRec.place);
-        break;
+    if (status != VM_OK) {
+        error() << "执行出错：" << VM::statusText(status) << endl;
+        return false;
     }
 
-    case 11: {
-        // E  T
-        if (!rec.empty()) newRec.place = rec[0].place;
-        break;
+    sink->message("\n执行结果：");
+    for (const auto& kv : runOutput) {
+        sink->message("  " + kv.first + " = " + to_string(kv.second));
+    }
+    if (runRepeat > 1) {
+        ostringstream line;
+        line << "重复执行 " << runRepeat << " 次，共 " << stats.executeMs << " ms，平均每次 "
+            << stats.executeMs * 1e6 / runRepeat << " ns";
+        sink->message(line.str());
     }
+    sink->message("");
+    return true;
+}
 
-    case 12: {
-        // T  T * F
-        string T1_place = rec[0].place;
-        string F_place = rec[2].place;
-        newRec.place = semantic.newtemp();
-        semantic.emit("*", T1_place, F_place, newRec.place);
-        break;
+// 编译为本地代码并加载，先与虚拟机做翻译确认，再按runInput执行
+bool Compiler::runNative() {
+    if (sink->enabled()) {
+        sink->message(nativeTarget == NATIVE_C ? NativeProgram::emitC(bytecode) : NativeProgram::emitAsm(bytecode));
     }
 
-    case 13: {
-        // T  T / F
-        string T1_place = rec[0].place;
-        string F_place = rec[2].place;
-        newRec.place = semantic.newtemp();
-        semantic.emit("/", T1_place, F_place, newRec.place);
-        break;
+    Stopwatch timer;
+    string error;
+    if (!native.build(bytecode, nativeTarget, error)) {
+        this->error() << error << endl;
+        return false;
     }
+    stats.nativeMs = timer.elapsedMs();
+    ostringstream line;
+    line << "本地代码已编译并加载，耗时 " << stats.nativeMs << " ms";
+    sink->message(line.str());
+
+    const int SAMPLES = 10000;
+    int mismatches = native.validate(bytecode, SAMPLES, this->error());
+    stats.nativeMismatches = mismatches;
+    if (mismatches > 0) {
+        this->error() << "翻译确认失败：" << SAMPLES << " 组随机输入中有 " << mismatches << " 组结果与虚拟机不一致" << endl;
+        return false;
+    }
+    sink->message("翻译确认通过：" + to_string(SAMPLES) + " 组随机输入的结果与虚拟机一致");
+
+    if (!execute) return true;
 
-    case 14: {
-        // T  F
-        if (!rec.empty()) newRec.place = rec[0].place;
-        break;
+    ProgramView view = bytecode.view();
+    vector<int64_t> init(view.slotCount(), 0);
+    for (int i = 0; i < view.varSlots; i++) {
+        auto it = runInput.find(bytecode.names[i]);
+        if (it != runInput.end()) init[i] = it->second;
+    }
+    vector<int64_t> regs(init);
+    VMStatus status = native.call(regs.data());
+    if (status != VM_OK) {
+        this->error() << "本地代码执行出错：" << VM::statusText(status) << endl;
+        return false;
     }
 
-    case 15: {
-        // F  ( E )
-        // rec: 0='(', 1=E, 2=')'
-        newRec.place = rec[1].place;
-        break;
+    sink->message("\n本地代码执行结果：");
+    for (int i = 0; i < view.varSlots; i++) {
+        sink->message("  " + bytecode.names[i] + " = " + to_string(regs[i]));
     }
 
-    case 16: {
-        // F  id
-        if (!rec.empty()) {
-            newRec.place = rec[0].idName;
-            newRec.idName = rec[0].idName;
+    if (runRepeat > 1) {
+        timer.restart();
+        for (int i = 0; i < runRepeat; i++) {
+            copy(init.begin(), init.end(), regs.begin());
+            native.call(regs.data());
         }
-        break;
+        double ms = timer.elapsedMs();
+        line.str("");
+        line << "重复执行 " << runRepeat << " 次，共 " << ms << " ms，平均每次 " << ms * 1e6 / runRepeat
+            << " ns（虚拟机 " << stats.executeMs * 1e6 / runRepeat << " ns）";
+        sink->message(line.str());
     }
+    sink->message("");
+    return true;
+}
 
-    case 17: {
-        // F  num
-        if (!rec.empty()) {
-            newRec.place = rec[0].numVal;
-            newRec.numVal = rec[0].numVal;
-        }
-        break;
+// 用随机生成的batchRows条记录比较逐条执行与列式批量执行的吞吐量，并核对结果
+bool Compiler::runBatch() {
+    ProgramView view = bytecode.view();
+    string error;
+    if (!BatchEvaluator::check(view, error)) {
+        this->error() << error << endl;
+        return false;
     }
 
-    default:
-        break;
+    size_t rows = batchRows;
+    vector<vector<int64_t>> columns(view.varSlots, vector<int64_t>(rows));
+    mt19937_64 rng(12345);
+    uniform_int_distribution<int64_t> dist(-1000, 1000);
+    for (auto& col : columns) {
+        for (int64_t& v : col) v = dist(rng);
     }
 
-    semStack.push(newRec);
+    // 逐条用虚拟机执行作为参照
+    vector<vector<int64_t>> expect = columns;
+    vector<uint8_t> expectStatus(rows);
+    vector<int64_t> regs(view.slotCount());
+    Stopwatch timer;
+    for (size_t i = 0; i < rows; i++) {
+        for (int s = 0; s < view.varSlots; s++) regs[s] = expect[s][i];
+        fill(regs.begin() + view.varSlots, regs.end(), 0);
+        expectStatus[i] = VM::execute(view, regs.data());
+        for (int s = 0; s < view.varSlots; s++) expect[s][i] = regs[s];
+    }
+    double vmMs = timer.elapsedMs();
+
+    ThreadPool pool(batchThreads);
+    vector<uint8_t> status;
+    timer.restart();
+    BatchEvaluator::run(view, columns, status, pool);
+    double batchMs = timer.elapsedMs();
+    stats.batchMs = batchMs;
+    stats.batchRows = rows;
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < rows; i++) {
+        bool same = status[i] == expectStatus[i];
+        for (int s = 0; same && s < view.varSlots; s++) same = columns[s][i] == expect[s][i];
+        if (!same) mismatches++;
+    }
+
+    int threads = pool.size();
+    double perCore = batchMs > 0 ? rows / (batchMs / 1000.0) / threads : 0;
+    double vmRate = vmMs > 0 ? rows / (vmMs / 1000.0) : 0;
+    ostringstream report;
+    report << "记录数 " << rows << "，线程数 " << threads << "\n";
+    report << "逐条执行（虚拟机）：" << vmMs << " ms，" << (long long)vmRate << " 条/秒\n";
+    report << "列式批量执行：" << batchMs << " ms，每核 " << (long long)perCore << " 条/秒";
+    sink->message(report.str());
+    if (mismatches > 0) {
+        this->error() << "批量执行结果与逐条执行不一致：" << mismatches << " 条记录" << endl;
+        return false;
+    }
+    sink->message("批量执行结果与逐条执行一致\n");
+    return true;
 }
 
 void Compiler::printAll() {
     parser.printGrammar();
     parser.printFirstSets();
     parser.printFollowSets();
-    // parser.printStates();  // Ŀ̫࣬ѡ
+    // parser.printStates();  // 项目集太多，可选
     parser.printTable();
 }
@@ -1,35 +1,159 @@
-#pragma once
-#ifndef COMPILER_H
-#define COMPILER_H
-
-#include "common.h"
-#include "lexer.h"
-#include "lr1_parser.h"
-#include "semantic.h"
-
-class Compiler {
-private:
-    Lexer lexer;
-    LR1Parser parser;
-    SemanticAnalyzer semantic;
-
-    vector<Token> tokens;
-
-    // LR(1)õջ
-    stack<int> stateStack;
-    stack<string> symbolStack;
-    stack<SemanticRecord> semStack;
-
-    // ִ嶯
-    void executeSemanticAction(int prodIndex, vector<SemanticRecord>& poppedRecords);
-
-public:
-    Compiler();
-
-    bool compile(const string& source);
-    bool lr1Parse();  // LR(1)﷨
-
-    void printAll();
-};
-
-#endif
+#pragma once
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "common.h"
+#include "lexer.h"
+#include "lr1_parser.h"
+#include "semantic.h"
+#include "optimizer.h"
+#include "vm.h"
+#include "native.h"
+#include "batch.h"
+#include "arena.h"
+#include "program_image.h"
+#include "output.h"
+#include "parse_profile.h"
+#include "alloc_stats.h"
+
+class Compiler {
+private:
+    // 单次编译的数据都从这里分配，须在使用它的成员之前构造
+    CompileArena arena;
+
+    Lexer lexer;
+    LR1Parser ownParser;
+    LR1Parser& parser;      // 共享时指向外部已构造好的分析器，只读使用
+    bool sharedParser;
+    SemanticAnalyzer semantic;
+
+    TokenList tokens;
+
+    // 词法和语法错误，分析出错后继续进行以便一次报告多处错误
+    vector<Diagnostic> diagnostics;
+
+    // 编译统计
+    CompileStats stats;
+
+    // 编译过程的输出经过sink；安静模式下不输出，错误只记录在diagnostics中
+    TextSink textSink;
+    NullSink nullSink;
+    unique_ptr<OutputSink> formatSink;  // 文本以外的格式
+    OutputSink* sink;
+    ostream err;
+
+    // 先写出缓冲的正常输出再返回错误流，保持两者的先后顺序
+    ostream& error() { sink->flush(); return err; }
+
+    bool optimize;  // 是否对生成的四元式做优化
+
+    // 不输出分析过程时使用由分析表生成的直接编码分析器（direct_parser.inc），
+    // 出错时退回表驱动分析以便报告和恢复
+    bool directParse;
+
+    // 非空时记录表驱动分析中各表项的访问次数（此时不使用直接编码分析器）
+    ParseProfile* profile;
+
+    // 编译后用字节码虚拟机执行
+    bool execute;
+    map<string, int64_t> runInput;
+    int runRepeat;
+    map<string, int64_t> runOutput;
+    Bytecode bytecode;
+
+    // 本地代码后端
+    NativeTarget nativeTarget;
+    NativeProgram native;
+
+    // 列式批量执行
+    int batchRows;
+    int batchThreads;
+
+    string objectPath;  // 目标文件输出路径，为空时不输出
+
+    bool executeProgram();
+    bool runNative();
+    bool runBatch();
+
+    // 直接编码分析器的回调，见 direct_parser.h
+    struct DirectActions;
+    bool runDirectParse(const pmr::vector<int>& termIds);
+    void pushToken(const Token& tok);   // 移进单词时压入语义记录
+
+    // 语法错误恢复（应急模式）
+    void reportSyntaxError(int state, const Token& tok);
+    bool recover(int& ip, const pmr::vector<int>& termIds);
+    void printDiagnostics();
+
+    // LR(1)分析用的栈（栈顶在末尾）
+    pmr::vector<int> stateStack;
+    pmr::vector<string> symbolStack;
+    pmr::vector<SemanticRecord> semStack;
+
+    // 让所有使用内存区的容器放弃存储，然后整体释放内存区
+    void resetArena();
+
+    // 语义动作分派表：按产生式编号索引，nullptr表示无需任何处理的单产生式
+    typedef void (*ReduceFn)(Compiler& c, int len);
+    vector<ReduceFn> reduceActions;
+    bool bindSemanticActions();
+
+    // 右部长度为Len的归约：语义动作直接读取栈顶Len个记录，结果写回rhs[0]
+    template <int Len, void (*Action)(Compiler&, SemanticRecord*)>
+    static void reduce(Compiler& c, int len);
+    static void reducePass(Compiler& c, int len);
+
+    // 各语义动作，rhs指向右部第一个符号的语义记录
+    static void actAssign(Compiler& c, SemanticRecord* rhs);
+    static void actIf(Compiler& c, SemanticRecord* rhs);
+    static void actIfElse(Compiler& c, SemanticRecord* rhs);
+    static void actSeq(Compiler& c, SemanticRecord* rhs);
+    static void actCond(Compiler& c, SemanticRecord* rhs);
+    static void actMark(Compiler& c, SemanticRecord* rhs);
+    static void actJump(Compiler& c, SemanticRecord* rhs);
+    static void actAdd(Compiler& c, SemanticRecord* rhs);
+    static void actSub(Compiler& c, SemanticRecord* rhs);
+    static void actMul(Compiler& c, SemanticRecord* rhs);
+    static void actDiv(Compiler& c, SemanticRecord* rhs);
+    static void actParen(Compiler& c, SemanticRecord* rhs);
+
+    // 依次执行各编译阶段
+    bool compilePhases(string_view source);
+
+public:
+    // shared非空时使用外部的分析器（须已init），多个编译器可以在不同线程中共享它
+    explicit Compiler(LR1Parser* shared = nullptr);
+
+    bool compile(string_view source);   // 源码不被复制，编译期间须保持有效
+    bool lr1Parse();  // LR(1)驱动的语法分析
+
+    void printAll();
+
+    LR1Parser& getParser() { return parser; }
+    void setOptimize(bool on) { optimize = on; }
+    void setDirectParse(bool on) { directParse = on; }
+    void setProfile(ParseProfile* p) { profile = p; }
+    bool directParseAvailable() const;  // 生成的分析器是否与当前文法一致
+    void setQuiet(bool on);
+    void setErrorOutput(streambuf* sb) { err.rdbuf(sb); }   // 编译器内部错误的去向，nullptr表示丢弃
+    void setOutputFormat(OutputFormat format);
+    void setRunInput(const map<string, int64_t>& input, int repeat = 1);
+    const map<string, int64_t>& getRunOutput() const { return runOutput; }
+    void setNativeTarget(NativeTarget t) { nativeTarget = t; }
+    void setBatch(int rows, int threads) { batchRows = rows; batchThreads = threads; }
+    void setObjectOutput(const string& path) { objectPath = path; }
+    void setLexThreads(int n) { lexer.setThreads(n); }
+
+    const CompileStats& getStats() const { return stats; }
+    const vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
+    const TokenList& getTokens() const { return tokens; }
+    const QuadList& getCode() const { return semantic.getCode(); }
+    void printStatsJson(ostream& out);
+
+    // 对上次编译的单词序列分别用表驱动和直接编码的分析器重复分析，比较耗时并核对结果
+    bool benchmarkParse(int repeat);
+    // 用1、2、4……直到maxThreads个线程分块分析source，报告词法分析吞吐量随线程数的变化
+    bool benchmarkLex(string_view source, int repeat, int maxThreads);
+};
+
+#endif
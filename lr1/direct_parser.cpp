@@ -0,0 +1,117 @@
+#include "direct_parser.h"
+
+string DirectParserGenerator::generate(const LR1Parser& parser) {
+    int states = parser.getStateCount();
+    int terms = parser.terminalCount();
+    int prods = parser.getProductionCount();
+
+    ostringstream out;
+    out << "// 由 lr1 --gen-direct 根据分析表生成，请勿手工修改\n";
+    out << "// 文法哈希 " << parser.getGrammarHash() << "，" << states << " 个状态\n";
+    out << "#pragma once\n\n";
+    out << "#define LR1_DIRECT_GRAMMAR \"" << parser.getLayoutHash() << "\"\n\n";
+    out << "template <class Actions, class Stack>\n";
+    out << "bool lr1DirectParse(const int* terms, int& ip, Stack& stack, Actions& act) {\n";
+    out << "    stack.clear();\n";
+    out << "    stack.push_back(0);\n";
+    out << "    goto S0;\n";
+
+    vector<bool> reduced(prods, false);
+
+    for (int s = 0; s < states; s++) {
+        out << "\nS" << s << ":\n";
+        out << "    switch (terms[ip]) {\n";
+
+        // 动作相同的终结符合并为一组case
+        map<int, vector<int>> groups;
+        for (int t = 0; t < terms; t++) {
+            int action = parser.actionAt(s, t);
+            if (action != ACTION_ERROR) groups[action].push_back(t);
+        }
+        for (const auto& g : groups) {
+            for (int t : g.second) {
+                out << "    case " << t << ":    // " << parser.terminalName(t) << "\n";
+            }
+            int action = g.first;
+            if (action == ACTION_ACCEPT) {
+                out << "        return true;\n";
+            }
+            else if (action > 0) {
+                out << "        stack.push_back(" << action - 1 << ");\n";
+                out << "        act.shift(ip++);\n";
+                out << "        goto S" << action - 1 << ";\n";
+            }
+            else {
+                int p = -action - 1;
+                reduced[p] = true;
+                out << "        goto R" << p << ";\n";
+            }
+        }
+        out << "    default:\n";
+        out << "        return false;\n";
+        out << "    }\n";
+    }
+
+    // 归约：弹出右部，执行语义动作，转到左部的GOTO分派
+    vector<bool> lhsUsed(parser.nonTerminalCount(), false);
+    for (int p = 0; p < prods; p++) {
+        if (!reduced[p]) continue;
+        int len = parser.getProduction(p).len;
+        int lhs = parser.productionLhsId(p);
+        lhsUsed[lhs] = true;
+        out << "\nR" << p << ":    // " << parser.productionToString(p) << "\n";
+        if (len > 0) out << "    stack.resize(stack.size() - " << len << ");\n";
+        out << "    act.reduce(" << p << ", " << len << ");\n";
+        out << "    goto G" << lhs << ";\n";
+    }
+
+    for (int nt = 0; nt < parser.nonTerminalCount(); nt++) {
+        if (!lhsUsed[nt]) continue;
+        out << "\nG" << nt << ":    // " << parser.nonTerminalName(nt) << "\n";
+        out << "    switch (stack.back()) {\n";
+        for (int s = 0; s < states; s++) {
+            int g = parser.gotoAt(s, nt);
+            if (g < 0) continue;
+            // 启用单产生式短路时，向前看决定直接转到链末的哪个状态
+            map<int, vector<int>> chains;
+            if (parser.hasUnitChains()) {
+                for (int t = 0; t < terms; t++) {
+                    int q = parser.chainGotoAt(s, nt, t);
+                    if (q != g) chains[q].push_back(t);
+                }
+            }
+            if (chains.empty()) {
+                out << "    case " << s << ": stack.push_back(" << g << "); goto S" << g << ";\n";
+                continue;
+            }
+            out << "    case " << s << ":\n";
+            out << "        switch (terms[ip]) {\n";
+            for (const auto& c : chains) {
+                for (int t : c.second) {
+                    out << "        case " << t << ":    // " << parser.terminalName(t) << "\n";
+                }
+                out << "            stack.push_back(" << c.first << "); goto S" << c.first << ";\n";
+            }
+            out << "        default: stack.push_back(" << g << "); goto S" << g << ";\n";
+            out << "        }\n";
+        }
+        out << "    default:\n";
+        out << "        return false;\n";
+        out << "    }\n";
+    }
+
+    out << "}\n";
+    return out.str();
+}
+
+bool DirectParserGenerator::write(const LR1Parser& parser, const string& path, string& error) {
+    string code = generate(parser);
+    ofstream out(path, ios::binary);
+    out.write(code.data(), code.size());
+    out.close();
+    if (!out) {
+        error = "无法写入文件：" + path;
+        return false;
+    }
+    return true;
+}
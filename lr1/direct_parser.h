@@ -0,0 +1,25 @@
+#pragma once
+#ifndef DIRECT_PARSER_H
+#define DIRECT_PARSER_H
+
+#include "common.h"
+#include "lr1_parser.h"
+
+// ==================== 直接编码分析器生成 ====================
+// 由构造好的LR(1)分析表生成C++源码：每个状态一段代码，按终结符编号switch，
+// 移进直接跳到目标状态，归约后经左部非终结符的小switch跳到GOTO状态。
+// 生成的函数模板形如
+//   template <class Actions, class Stack>
+//   bool lr1DirectParse(const int* terms, int& ip, Stack& stack, Actions& act);
+// terms为终结符编号序列（以'#'结束），stack为状态栈；
+// 移进时调用 act.shift(ip)，归约时在弹栈后调用 act.reduce(产生式编号, 右部长度)。
+// 接受时返回true，出错时返回false，ip指向出错的单词。
+// 生成的代码不依赖运行时的分析表，但终结符编号须一致，
+// 使用前须核对 LR1_DIRECT_GRAMMAR 与分析表的排列（LR1Parser::getLayoutHash）一致
+class DirectParserGenerator {
+public:
+    static string generate(const LR1Parser& parser);
+    static bool write(const LR1Parser& parser, const string& path, string& error);
+};
+
+#endif
@@ -1,8 +1,13 @@
 #include "lexer.h"
+#include "thread_pool.h"
+#include "alloc_stats.h"
 
-Lexer::Lexer() : input(""), pos(0), line(1) {}
+// 并行分析时每块至少这么长，较短的源码分块得不偿失
+static const size_t LEX_CHUNK_MIN = 256 * 1024;
 
-void Lexer::setInput(const string& src) {
+Lexer::Lexer(pmr::memory_resource* mr) : input(""), pos(0), line(1), memory(mr), threads(1), chunksUsed(1) {}
+
+void Lexer::setInput(string_view src) {
     input = src;
     pos = 0;
     line = 1;
@@ -75,7 +80,7 @@ Token Lexer::scanOperator() {
     case ')': return Token(TOKEN_RPAREN, ")", startLine);
     case '{': return Token(TOKEN_LBRACE, "{", startLine);
     case '}': return Token(TOKEN_RBRACE, "}", startLine);
-    case ';': return Token(TOKEN_SEMI, ";", startLine);  // ֺŵ
+    case ';': return Token(TOKEN_SEMI, ";", startLine);  // 分号单独处理
     case '=':
         if (peek() == '=') { advance(); return Token(TOKEN_EQ, "==", startLine); }
         return Token(TOKEN_ASSIGN, "=", startLine);
@@ -87,19 +92,36 @@ Token Lexer::scanOperator() {
         return Token(TOKEN_GT, ">", startLine);
     case '!':
         if (peek() == '=') { advance(); return Token(TOKEN_NE, "!=", startLine); }
-        cerr << "ʷ󣺷Ƿַ '!' ڵ " << startLine << " " << endl;
+        diagnostics.push_back(Diagnostic(startLine, "词法错误：非法字符 '!'"));
         return Token(TOKEN_ERROR, "!", startLine);
     default:
-        cerr << "ʷ󣺷Ƿַ '" << c << "' ڵ " << startLine << " " << endl;
+        diagnostics.push_back(Diagnostic(startLine, string("词法错误：非法字符 '") + c + "'"));
         return Token(TOKEN_ERROR, string(1, c), startLine);
     }
 }
 
-vector<Token> Lexer::tokenize() {
-    vector<Token> tokens;
+TokenList Lexer::tokenize() {
+    LR1_ALLOC_SCOPE(ALLOC_LEX);
     pos = 0;
     line = 1;
+    diagnostics.clear();
+
+    int poolThreads = threads > 0 ? threads : (int)thread::hardware_concurrency();
+    size_t chunks = min((size_t)max(poolThreads, 1), input.length() / LEX_CHUNK_MIN);
+    if (chunks >= 2) return tokenizeParallel((int)chunks, poolThreads);
+    chunksUsed = 1;
+
+    TokenList tokens(memory);
+    // 按源码长度估计单词数，减少扩容次数。大块存储直接来自全局分配器，
+    // 估计偏大时未写到的页不占物理内存，偏小时扩容丢下的旧块也会归还
+    tokens.reserve(input.length() / 2 + 2);
+    scan(tokens);
+    tokens.push_back(Token(TOKEN_END, "#", line));
+    return tokens;
+}
 
+// 分析input中pos之后的全部单词（不含结束符），line随换行递增
+void Lexer::scan(TokenList& tokens) {
     while (pos < input.length()) {
         skipWhitespace();
         if (pos >= input.length()) break;
@@ -117,16 +139,72 @@ vector<Token> Lexer::tokenize() {
             token = scanOperator();
         }
 
-        // ֺţtokenУֺΪָ﷨
-        if (token.type == TOKEN_SEMI) {
+        // 跳过分号，不加入token序列（分号作为语句分隔符但不参与语法分析）
+        // 非法字符已记录错误，同样跳过
+        if (token.type == TOKEN_SEMI || token.type == TOKEN_ERROR) {
             continue;
         }
 
         tokens.push_back(token);
-        if (token.type == TOKEN_ERROR) break;
     }
+}
 
-    tokens.push_back(Token(TOKEN_END, "#", line));
+// 在空白处把源码切成若干块，各块从第1行起独立分析，再按各块换行数的前缀和修正行号。
+// 单词不含空白，所以在空白处切开不会改变任何单词，结果与顺序分析逐个相同
+TokenList Lexer::tokenizeParallel(int chunks, int poolThreads) {
+    vector<size_t> bounds(1, 0);
+    for (int k = 1; k < chunks; k++) {
+        size_t p = max(input.length() * k / chunks, bounds.back());
+        while (p < input.length() && input[p] != ' ' && input[p] != '\t' && input[p] != '\r' && input[p] != '\n') p++;
+        if (p > bounds.back() && p < input.length()) bounds.push_back(p);
+    }
+    bounds.push_back(input.length());
+    size_t n = bounds.size() - 1;
+    chunksUsed = n;
+
+    // 各块的单词先放在各自线程的普通堆上，内存区不是线程安全的
+    vector<TokenList> parts;
+    vector<vector<Diagnostic>> partDiagnostics(n);
+    vector<int> newlines(n);
+    for (size_t k = 0; k < n; k++) parts.push_back(TokenList(pmr::new_delete_resource()));
+
+    ThreadPool pool(min(poolThreads, (int)n));
+    pool.parallelFor(n, [&](size_t k) {
+        Lexer part(pmr::new_delete_resource());
+        part.setInput(input.substr(bounds[k], bounds[k + 1] - bounds[k]));
+        parts[k].reserve((bounds[k + 1] - bounds[k]) / 2 + 2);
+        part.scan(parts[k]);
+        newlines[k] = part.line - 1;
+        partDiagnostics[k].swap(part.diagnostics);
+    });
+
+    // 前缀和：第k块之前的换行数即为该块的行号偏移
+    vector<size_t> start(n + 1, 0);
+    vector<int> lineOffset(n + 1, 0);
+    for (size_t k = 0; k < n; k++) {
+        start[k + 1] = start[k] + parts[k].size();
+        lineOffset[k + 1] = lineOffset[k] + newlines[k];
+    }
+
+    TokenList tokens(memory);
+    tokens.resize(start[n] + 1);
+    pool.parallelFor(n, [&](size_t k) {
+        Token* out = &tokens[start[k]];
+        for (Token& t : parts[k]) {
+            t.line += lineOffset[k];
+            *out++ = move(t);
+        }
+    });
+    for (size_t k = 0; k < n; k++) {
+        for (Diagnostic& d : partDiagnostics[k]) {
+            d.line += lineOffset[k];
+            diagnostics.push_back(move(d));
+        }
+    }
+
+    pos = input.length();
+    line = 1 + lineOffset[n];
+    tokens.back() = Token(TOKEN_END, "#", line);
     return tokens;
 }
 
@@ -157,7 +235,7 @@ string tokenTypeToString(TokenType type) {
     }
 }
 
-// Tokenתķ
+// Token转文法符号
 string tokenToSymbol(const Token& tok) {
     switch (tok.type) {
     case TOKEN_IF: return "if";
@@ -180,19 +258,3 @@ string tokenToSymbol(const Token& tok) {
     default: return "ERROR";
     }
 }
-
-void Lexer::printTokens(const vector<Token>& tokens) {
-    cout << "\n===================== ʷ =====================" << endl;
-    cout << setw(8) << "" << setw(12) << "" << setw(12) << ""
-        << setw(12) << "ֵ" << setw(8) << "к" << endl;
-    cout << "--------------------------------------------------------" << endl;
-
-    for (size_t i = 0; i < tokens.size(); i++) {
-        cout << setw(8) << i
-            << setw(12) << tokens[i].type
-            << setw(12) << tokenTypeToString(tokens[i].type)
-            << setw(12) << tokens[i].value
-            << setw(8) << tokens[i].line << endl;
-    }
-    cout << "========================================================\n" << endl;
-}
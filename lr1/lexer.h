@@ -1,29 +1,37 @@
-#pragma once
-#ifndef LEXER_H
-#define LEXER_H
-
-#include "common.h"
-
-class Lexer {
-private:
-    string input;
-    size_t pos;
-    int line;
-
-    char peek();
-    char advance();
-    void skipWhitespace();
-    bool isLetter(char c);
-    bool isDigit(char c);
-    Token scanIdentifier();
-    Token scanNumber();
-    Token scanOperator();
-
-public:
-    Lexer();
-    void setInput(const string& src);
-    vector<Token> tokenize();
-    void printTokens(const vector<Token>& tokens);
-};
-
-#endif
+#pragma once
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "common.h"
+
+class Lexer {
+private:
+    string_view input;  // 不复制源码，调用者须保证分析期间有效
+    size_t pos;
+    int line;
+    vector<Diagnostic> diagnostics;     // 本次分析发现的词法错误
+    pmr::memory_resource* memory;       // 单词序列的存储来源
+    int threads;                        // 分块并行分析的线程数，0表示全部硬件线程，1表示不并行
+    int chunksUsed;                     // 上次分析实际切成的块数
+
+    char peek();
+    char advance();
+    void skipWhitespace();
+    bool isLetter(char c);
+    bool isDigit(char c);
+    Token scanIdentifier();
+    Token scanNumber();
+    Token scanOperator();
+    void scan(TokenList& tokens);
+    TokenList tokenizeParallel(int chunks, int poolThreads);
+
+public:
+    explicit Lexer(pmr::memory_resource* mr = pmr::get_default_resource());
+    void setInput(string_view src);
+    void setThreads(int n) { threads = n; }
+    TokenList tokenize();   // 遇到非法字符时记录错误并跳过，继续分析
+    const vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
+    int getChunks() const { return chunksUsed; }
+};
+
+#endif
@@ -1,73 +1,334 @@
 #include "lr1_parser.h"
-
-LR1Parser::LR1Parser() {
-    startSymbol = "S'";
+#include "thread_pool.h"
+#include "parse_profile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+size_t ItemSetHash::operator()(const set<LR1Item>& items) const {
+    hash<string> strHash;
+    size_t h = items.size();
+    for (const LR1Item& item : items) {
+        size_t k = ((size_t)item.prodIndex * 1000003u) ^ ((size_t)item.dotPos * 131u) ^ strHash(item.lookahead);
+        h ^= k + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+    return h;
 }
 
-// ʼķ - ϸտ趨Ĳʽ
-void LR1Parser::initGrammar() {
-    productions.clear();
+KernelTable::Entry* KernelTable::findOrInsert(const set<LR1Item>& kernel, bool& inserted) {
+    Shard& shard = shards[ItemSetHash()(kernel) % SHARDS];
+    lock_guard<mutex> guard(shard.lock);
 
-    // (0)  S'  S
-    productions.push_back(Production("S'", { "S" }));
+    unique_ptr<Entry>& slot = shard.map[kernel];
+    inserted = !slot;
+    if (inserted) {
+        slot.reset(new Entry());
+    }
+    return slot.get();
+}
 
-    // (1)  S  id = E
-    productions.push_back(Production("S", { "id", "=", "E" }));
+void KernelTable::clear() {
+    for (Shard& shard : shards) {
+        lock_guard<mutex> guard(shard.lock);
+        shard.map.clear();
+    }
+}
 
-    // (2)  S  if ( C ) M { L } N
-    productions.push_back(Production("S", { "if", "(", "C", ")", "M", "{", "L", "}", "N" }));
+LR1Parser::LR1Parser() : buildThreads(0), stateCount(0), cacheDir(), unitElimination(false),
+    progress(cout.rdbuf()), err(cerr.rdbuf()), closureCalls(0), itemsCreated(0), closureHits(0) {
+    startSymbol = "S'";
+}
 
-    // (3)  S  if ( C ) M { L } N else M { L }
-    productions.push_back(Production("S", { "if", "(", "C", ")", "M", "{", "L", "}", "N", "else", "M", "{", "L", "}" }));
+void LR1Parser::setStreams(streambuf* progressOut, streambuf* errorOut) {
+    progress.rdbuf(progressOut);
+    err.rdbuf(errorOut);
+}
 
-    // (4)  L  L M S
-    productions.push_back(Production("L", { "L", "M", "S" }));
+// 内置文法 - 严格按照课设定义的产生式，格式与文法文件相同（见 ifelse.grammar）
+static const char* DEFAULT_GRAMMAR = R"GRAMMAR(
+%token   id num if else = rop + - * / ( ) { }
+%nonterm S' S L C E T F M N
+
+S' -> S                                       // (0)
+S  -> id = E                                  @assign     // (1)
+   |  if ( C ) M { L } N                      @if         // (2)
+   |  if ( C ) M { L } N else M { L }         @if_else    // (3)
+L  -> L M S                                   @seq        // (4)
+   |  S                                                   // (5)
+C  -> E rop E                                 @cond       // (6)
+M  -> %empty                                  @mark       // (7)
+N  -> %empty                                  @jump       // (8)
+E  -> E + T                                   @add        // (9)
+   |  E - T                                   @sub        // (10)
+   |  T                                                   // (11)
+T  -> T * F                                   @mul        // (12)
+   |  T / F                                   @div        // (13)
+   |  F                                                   // (14)
+F  -> ( E )                                   @paren      // (15)
+   |  id                                      @id         // (16)
+   |  num                                     @num        // (17)
+)GRAMMAR";
+
+// 初始化文法：读取文法文件，未指定时使用内置文法
+bool LR1Parser::initGrammar() {
+    if (grammarPath.empty()) {
+        return parseGrammar(DEFAULT_GRAMMAR, "<内置文法>");
+    }
 
-    // (5)  L  S
-    productions.push_back(Production("L", { "S" }));
+    ifstream file(grammarPath, ios::binary);
+    if (!file.is_open()) {
+        err << "无法打开文法文件：" << grammarPath << endl;
+        return false;
+    }
+    stringstream buffer;
+    buffer << file.rdbuf();
+    return parseGrammar(buffer.str(), grammarPath);
+}
 
-    // (6)  C  E rop E
-    productions.push_back(Production("C", { "E", "rop", "E" }));
+// 解析BNF文法文本
+// 每行 "A -> X Y @label"，"|" 分隔候选式，以 "|" 开头的行续写上一个左部；
+// %empty 表示ε，// 之后为注释，%token / %nonterm 声明符号顺序
+bool LR1Parser::parseGrammar(const string& text, const string& origin) {
+    productions.clear();
+    terminals.clear();
+    nonTerminals.clear();
+    terminalOrder.clear();
+    nonTerminalOrder.clear();
+    terminalIds.clear();
+    nonTerminalIds.clear();
+    productionLhs.clear();
+    precedenceLevels.clear();
+    terminalPrec.clear();
+    productionPrec.clear();
+    productionPrecToken.clear();
+
+    vector<string> declaredTokens, declaredNonTerms;
+    vector<string> rhsOrder;    // 右部符号首次出现的顺序
+    istringstream in(text);
+    string line, currentLeft;
+    int lineNo = 0;
+
+    while (getline(in, line)) {
+        lineNo++;
+        size_t comment = line.find("//");
+        if (comment != string::npos) line.erase(comment);
+
+        vector<string> words;
+        istringstream ls(line);
+        string w;
+        while (ls >> w) words.push_back(w);
+        if (words.empty()) continue;
+
+        if (words[0] == "%token" || words[0] == "%nonterm") {
+            vector<string>& decl = words[0] == "%token" ? declaredTokens : declaredNonTerms;
+            decl.insert(decl.end(), words.begin() + 1, words.end());
+            continue;
+        }
 
-    // (7)  M  
-    productions.push_back(Production("M", { "" }));
+        // 每行一个优先级，后声明的优先级高
+        if (words[0] == "%left" || words[0] == "%right" || words[0] == "%nonassoc") {
+            Assoc assoc = words[0] == "%left" ? ASSOC_LEFT : words[0] == "%right" ? ASSOC_RIGHT : ASSOC_NONASSOC;
+            for (size_t i = 1; i < words.size(); i++) {
+                if (terminalPrec.count(words[i])) {
+                    err << origin << ":" << lineNo << ": " << words[i] << " 的优先级重复声明" << endl;
+                    return false;
+                }
+                terminalPrec[words[i]] = precedenceLevels.size();
+            }
+            precedenceLevels.push_back(make_pair(assoc, vector<string>(words.begin() + 1, words.end())));
+            continue;
+        }
 
-    // (8)  N  
-    productions.push_back(Production("N", { "" }));
+        size_t start;
+        if (words[0] == "|") {
+            if (currentLeft.empty()) {
+                err << origin << ":" << lineNo << ": 续行 \"|\" 之前没有产生式" << endl;
+                return false;
+            }
+            start = 1;
+        }
+        else if (words.size() >= 2 && (words[1] == "->" || words[1] == "::=")) {
+            currentLeft = words[0];
+            start = 2;
+        }
+        else {
+            err << origin << ":" << lineNo << ": 缺少 \"->\"" << endl;
+            return false;
+        }
 
-    // (9)  E  E + T
-    productions.push_back(Production("E", { "E", "+", "T" }));
+        // 按 "|" 切分候选式
+        vector<string> alt;
+        for (size_t i = start; i <= words.size(); i++) {
+            if (i < words.size() && words[i] != "|") {
+                alt.push_back(words[i]);
+                continue;
+            }
 
-    // (10) E  E - T
-    productions.push_back(Production("E", { "E", "-", "T" }));
+            string label;
+            if (!alt.empty() && alt.back()[0] == '@') {
+                label = alt.back().substr(1);
+                alt.pop_back();
+            }
+            // %prec X：产生式取终结符X的优先级
+            string precToken;
+            if (alt.size() >= 2 && alt[alt.size() - 2] == "%prec") {
+                precToken = alt.back();
+                alt.resize(alt.size() - 2);
+            }
+            vector<string> right;
+            for (const string& sym : alt) {
+                if (sym == "%empty" || sym == "ε") continue;
+                if (sym == "%prec") {
+                    err << origin << ":" << lineNo << ": %prec 须位于候选式末尾（标签之前）" << endl;
+                    return false;
+                }
+                if (sym[0] == '@') {
+                    err << origin << ":" << lineNo << ": 标签 " << sym << " 必须位于候选式末尾" << endl;
+                    return false;
+                }
+                right.push_back(sym);
+                rhsOrder.push_back(sym);
+            }
+            if (right.empty()) right.push_back("ε");
 
-    // (11) E  T
-    productions.push_back(Production("E", { "T" }));
+            productions.push_back(Production(currentLeft, right, label));
+            productionPrecToken.push_back(precToken);
+            alt.clear();
+        }
+    }
 
-    // (12) T  T * F
-    productions.push_back(Production("T", { "T", "*", "F" }));
+    if (productions.empty()) {
+        err << origin << ": 文法中没有产生式" << endl;
+        return false;
+    }
 
-    // (13) T  T / F
-    productions.push_back(Production("T", { "T", "/", "F" }));
+    // 左部出现过的是非终结符，其余右部符号为终结符
+    for (const Production& prod : productions) {
+        nonTerminals.insert(prod.left);
+    }
+    for (const string& sym : rhsOrder) {
+        if (!isNonTerminal(sym)) terminals.insert(sym);
+    }
+    terminals.insert("#");
+
+    // 增广产生式检查
+    startSymbol = productions[0].left;
+    const Production& aug = productions[0];
+    if (aug.right.size() != 1 || !isNonTerminal(aug.right[0])) {
+        err << origin << ": 第一条产生式必须是增广产生式 S' -> S" << endl;
+        return false;
+    }
+    for (const string& sym : rhsOrder) {
+        if (sym == startSymbol) {
+            err << origin << ": 开始符号 " << startSymbol << " 不能出现在产生式右部" << endl;
+            return false;
+        }
+    }
 
-    // (14) T  F
-    productions.push_back(Production("T", { "F" }));
+    // 符号编号：先按声明顺序，再按首次出现顺序
+    for (const string& t : declaredTokens) {
+        if (!isTerminal(t)) {
+            err << origin << ": %token 声明的 " << t << " 不是终结符，已忽略" << endl;
+        }
+        else if (terminalIds.find(t) == terminalIds.end()) {
+            terminalIds[t] = terminalOrder.size();
+            terminalOrder.push_back(t);
+        }
+    }
+    for (const string& t : rhsOrder) {
+        if (isTerminal(t) && terminalIds.find(t) == terminalIds.end()) {
+            terminalIds[t] = terminalOrder.size();
+            terminalOrder.push_back(t);
+        }
+    }
+    if (terminalIds.find("#") == terminalIds.end()) {
+        terminalIds["#"] = terminalOrder.size();
+        terminalOrder.push_back("#");
+    }
 
-    // (15) F  ( E )
-    productions.push_back(Production("F", { "(", "E", ")" }));
+    for (const string& nt : declaredNonTerms) {
+        if (!isNonTerminal(nt)) {
+            err << origin << ": %nonterm 声明的 " << nt << " 不是非终结符，已忽略" << endl;
+        }
+        else if (nonTerminalIds.find(nt) == nonTerminalIds.end()) {
+            nonTerminalIds[nt] = nonTerminalOrder.size();
+            nonTerminalOrder.push_back(nt);
+        }
+    }
+    for (const Production& prod : productions) {
+        if (nonTerminalIds.find(prod.left) == nonTerminalIds.end()) {
+            nonTerminalIds[prod.left] = nonTerminalOrder.size();
+            nonTerminalOrder.push_back(prod.left);
+        }
+    }
 
-    // (16) F  id
-    productions.push_back(Production("F", { "id" }));
+    for (const Production& prod : productions) {
+        productionLhs.push_back(nonTerminalIds[prod.left]);
+    }
 
-    // (17) F  num
-    productions.push_back(Production("F", { "num" }));
+    // 产生式的优先级：%prec 指定的终结符，否则为右部最右一个有优先级的终结符
+    for (const auto& p : terminalPrec) {
+        if (!isTerminal(p.first)) {
+            err << origin << ": 声明了优先级的 " << p.first << " 不是终结符" << endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < productions.size(); i++) {
+        int prec = -1;
+        if (!productionPrecToken[i].empty()) {
+            auto it = terminalPrec.find(productionPrecToken[i]);
+            if (it == terminalPrec.end()) {
+                err << origin << ": %prec " << productionPrecToken[i] << " 没有声明优先级" << endl;
+                return false;
+            }
+            prec = it->second;
+        }
+        else {
+            for (const string& sym : productions[i].right) {
+                auto it = terminalPrec.find(sym);
+                if (it != terminalPrec.end()) prec = it->second;
+            }
+        }
+        productionPrec.push_back(prec);
+    }
 
-    // սϣֺţΪķвʹã
-    terminals = { "if", "else", "id", "num", "+", "-", "*", "/",
-                 "(", ")", "{", "}", "=", "rop", "#" };
+    // 规范化文本的哈希（FNV-1a 64位），作为分析表缓存的键
+    unsigned long long h = 14695981039346656037ull;
+    for (unsigned char c : normalizedGrammar()) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%016llx", h);
+    grammarHash = buf;
+
+    return true;
+}
 
-    // ս
-    nonTerminals = { "S'", "S", "L", "C", "E", "T", "F", "M", "N" };
+// 规范化的文法文本：去掉注释和多余空白，每条产生式一行
+string LR1Parser::normalizedGrammar() const {
+    string text = "lr1-table-v1\n%token";
+    for (const string& t : terminalOrder) text += " " + t;
+    text += "\n%nonterm";
+    for (const string& nt : nonTerminalOrder) text += " " + nt;
+    text += "\n";
+    // 没有优先级声明时文本与以前相同，已有的缓存和生成代码仍然有效
+    static const char* ASSOC_NAMES[] = { "%left", "%right", "%nonassoc" };
+    for (const auto& level : precedenceLevels) {
+        text += ASSOC_NAMES[level.first];
+        for (const string& t : level.second) text += " " + t;
+        text += "\n";
+    }
+    for (size_t i = 0; i < productions.size(); i++) {
+        const Production& prod = productions[i];
+        text += prod.left + " ->";
+        // 空产生式内部记为"ε"，源文件的编码不同时字节也不同，这里写成ASCII的%empty，哈希与编码无关
+        for (const string& sym : prod.right) text += " " + (sym == "ε" ? string("%empty") : sym);
+        if (!productionPrecToken[i].empty()) text += " %prec " + productionPrecToken[i];
+        if (!prod.label.empty()) text += " @" + prod.label;
+        text += "\n";
+    }
+    return text;
 }
 
 bool LR1Parser::isTerminal(const string& s) {
@@ -78,15 +339,17 @@ bool LR1Parser::isNonTerminal(const string& s) {
     return nonTerminals.find(s) != nonTerminals.end();
 }
 
-// FIRST
+// 计算FIRST集
 void LR1Parser::computeFirstSets() {
-    // սFIRST
+    firstSet.clear();
+
+    // 终结符的FIRST集是自身
     for (const string& t : terminals) {
         firstSet[t].insert(t);
     }
-    firstSet[""].insert("");
+    firstSet["ε"].insert("ε");
 
-    // ʼսFIRSTΪ
+    // 初始化非终结符的FIRST集为空
     for (const string& nt : nonTerminals) {
         firstSet[nt] = set<string>();
     }
@@ -99,38 +362,38 @@ void LR1Parser::computeFirstSets() {
             const string& A = prod.left;
             const vector<string>& alpha = prod.right;
 
-            // A  
-            if (alpha.size() == 1 && alpha[0] == "") {
-                if (firstSet[A].find("") == firstSet[A].end()) {
-                    firstSet[A].insert("");
+            // A → ε
+            if (alpha.size() == 1 && alpha[0] == "ε") {
+                if (firstSet[A].find("ε") == firstSet[A].end()) {
+                    firstSet[A].insert("ε");
                     changed = true;
                 }
                 continue;
             }
 
-            // A  X1 X2 ... Xn
+            // A → X1 X2 ... Xn
             bool allCanBeEmpty = true;
             for (size_t i = 0; i < alpha.size() && allCanBeEmpty; i++) {
                 const string& Xi = alpha[i];
 
-                // FIRST(Xi) - {}  FIRST(A)
+                // 将FIRST(Xi) - {ε} 加入 FIRST(A)
                 for (const string& f : firstSet[Xi]) {
-                    if (f != "" && firstSet[A].find(f) == firstSet[A].end()) {
+                    if (f != "ε" && firstSet[A].find(f) == firstSet[A].end()) {
                         firstSet[A].insert(f);
                         changed = true;
                     }
                 }
 
-                // XiܷƵ
-                if (firstSet[Xi].find("") == firstSet[Xi].end()) {
+                // 检查Xi能否推导出ε
+                if (firstSet[Xi].find("ε") == firstSet[Xi].end()) {
                     allCanBeEmpty = false;
                 }
             }
 
-            // XiƵ
+            // 如果所有Xi都能推导出ε
             if (allCanBeEmpty) {
-                if (firstSet[A].find("") == firstSet[A].end()) {
-                    firstSet[A].insert("");
+                if (firstSet[A].find("ε") == firstSet[A].end()) {
+                    firstSet[A].insert("ε");
                     changed = true;
                 }
             }
@@ -138,16 +401,17 @@ void LR1Parser::computeFirstSets() {
     }
 }
 
-// FOLLOW
+// 计算FOLLOW集
 void LR1Parser::computeFollowSets() {
-    // ʼ
+    followSet.clear();
+
+    // 初始化
     for (const string& nt : nonTerminals) {
         followSet[nt] = set<string>();
     }
 
     // FOLLOW(S') = {#}
-    followSet["S'"].insert("#");
-    followSet["S"].insert("#");
+    followSet[startSymbol].insert("#");
 
     bool changed = true;
     while (changed) {
@@ -157,28 +421,28 @@ void LR1Parser::computeFollowSets() {
             const string& A = prod.left;
             const vector<string>& alpha = prod.right;
 
-            if (alpha.size() == 1 && alpha[0] == "") continue;
+            if (alpha.size() == 1 && alpha[0] == "ε") continue;
 
             for (size_t i = 0; i < alpha.size(); i++) {
                 const string& B = alpha[i];
 
                 if (!isNonTerminal(B)) continue;
 
-                //  = alpha[i+1...]FIRST
+                // 计算β = alpha[i+1...]的FIRST集
                 set<string> firstBeta;
                 bool betaCanBeEmpty = true;
 
                 for (size_t j = i + 1; j < alpha.size() && betaCanBeEmpty; j++) {
                     const string& Xj = alpha[j];
                     for (const string& f : firstSet[Xj]) {
-                        if (f != "") firstBeta.insert(f);
+                        if (f != "ε") firstBeta.insert(f);
                     }
-                    if (firstSet[Xj].find("") == firstSet[Xj].end()) {
+                    if (firstSet[Xj].find("ε") == firstSet[Xj].end()) {
                         betaCanBeEmpty = false;
                     }
                 }
 
-                // FOLLOW(B) = FIRST() - {}
+                // FOLLOW(B) ∪= FIRST(β) - {ε}
                 for (const string& f : firstBeta) {
                     if (followSet[B].find(f) == followSet[B].end()) {
                         followSet[B].insert(f);
@@ -186,7 +450,7 @@ void LR1Parser::computeFollowSets() {
                     }
                 }
 
-                // Ϊջ =>* ţ FOLLOW(B) = FOLLOW(A)
+                // 如果β为空或β =>* ε，则 FOLLOW(B) ∪= FOLLOW(A)
                 if (i == alpha.size() - 1 || betaCanBeEmpty) {
                     for (const string& f : followSet[A]) {
                         if (followSet[B].find(f) == followSet[B].end()) {
@@ -200,242 +464,790 @@ void LR1Parser::computeFollowSets() {
     }
 }
 
-// ȡеFIRST
+// 获取符号序列的FIRST集
 set<string> LR1Parser::getFirstOfSequence(const vector<string>& seq, size_t start) {
     set<string> result;
 
     if (start >= seq.size()) {
-        result.insert("");
+        result.insert("ε");
         return result;
     }
 
     bool allCanBeEmpty = true;
     for (size_t i = start; i < seq.size() && allCanBeEmpty; i++) {
-        const string& Xi = seq[i];
+        // 用at而非[]：构造项目集族时多个线程同时读取FIRST集
+        const set<string>& firstXi = firstSet.at(seq[i]);
 
-        for (const string& f : firstSet[Xi]) {
-            if (f != "") result.insert(f);
+        for (const string& f : firstXi) {
+            if (f != "ε") result.insert(f);
         }
 
-        if (firstSet[Xi].find("") == firstSet[Xi].end()) {
+        if (firstXi.find("ε") == firstXi.end()) {
             allCanBeEmpty = false;
         }
     }
 
     if (allCanBeEmpty) {
-        result.insert("");
+        result.insert("ε");
     }
 
     return result;
 }
 
-// հ
-set<LR1Item> LR1Parser::closure(const set<LR1Item>& items) {
-    set<LR1Item> result = items;
-    bool changed = true;
-
-    while (changed) {
-        changed = false;
-        set<LR1Item> toAdd;
-
-        for (const LR1Item& item : result) {
-            const Production& prod = productions[item.prodIndex];
-
-            // ǦŲʽ
-            if (prod.right[0] == "" || item.dotPos >= (int)prod.right.size()) {
-                continue;
-            }
+// 预计算闭包模板
+// 对核心项 [A → α·Bβ, a]，闭包加入的项目只取决于B和 L = FIRST(βa)：
+// 每个可由B经最左符号到达的非终结符C，其产生式的向前看符号为
+// spontaneous(C)，若propagates(C)再并上L。对每个B求一次不动点即可。
+void LR1Parser::buildClosureTemplates() {
+    suffixFirst.assign(productions.size(), vector<set<string>>());
+    for (size_t p = 0; p < productions.size(); p++) {
+        const vector<string>& right = productions[p].right;
+        if (right[0] == "ε") continue;
+        for (size_t i = 0; i <= right.size(); i++) {
+            suffixFirst[p].push_back(getFirstOfSequence(right, i));
+        }
+    }
 
-            string B = prod.right[item.dotPos];  // ķ
+    closureTemplates.clear();
+    for (const string& B : nonTerminals) {
+        map<string, set<string>> spontaneous;
+        map<string, bool> propagates;
+        spontaneous[B] = set<string>();
+        propagates[B] = true;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t p = 0; p < productions.size(); p++) {
+                const Production& prod = productions[p];
+                if (propagates.find(prod.left) == propagates.end()) continue;
+                if (prod.right[0] == "ε" || !isNonTerminal(prod.right[0])) continue;
+
+                // [C → ·Dη, x] 使D的产生式获得 FIRST(η) - {ε}，η可空时再加上x
+                const string& C = prod.left;
+                const string& D = prod.right[0];
+                const set<string>& firstEta = suffixFirst[p][1];
+                bool etaNullable = firstEta.find("ε") != firstEta.end();
+
+                if (propagates.find(D) == propagates.end()) {
+                    spontaneous[D] = set<string>();
+                    propagates[D] = false;
+                    changed = true;
+                }
 
-            if (isNonTerminal(B)) {
-                //  a  FIRST
-                vector<string> betaA;
-                for (size_t i = item.dotPos + 1; i < prod.right.size(); i++) {
-                    betaA.push_back(prod.right[i]);
+                set<string>& target = spontaneous[D];
+                size_t before = target.size();
+                for (const string& f : firstEta) {
+                    if (f != "ε") target.insert(f);
                 }
-                betaA.push_back(item.lookahead);
-
-                set<string> firstBetaA = getFirstOfSequence(betaA, 0);
-
-                // BÿʽĿ
-                for (size_t i = 0; i < productions.size(); i++) {
-                    if (productions[i].left == B) {
-                        for (const string& b : firstBetaA) {
-                            if (b != "") {
-                                LR1Item newItem(i, 0, b);
-                                if (result.find(newItem) == result.end() &&
-                                    toAdd.find(newItem) == toAdd.end()) {
-                                    toAdd.insert(newItem);
-                                    changed = true;
-                                }
-                            }
-                        }
+                if (etaNullable) {
+                    const set<string>& fromC = spontaneous[C];
+                    target.insert(fromC.begin(), fromC.end());
+                    if (propagates[C] && !propagates[D]) {
+                        propagates[D] = true;
+                        changed = true;
                     }
                 }
+                if (target.size() != before) changed = true;
             }
         }
 
-        for (const LR1Item& item : toAdd) {
-            result.insert(item);
+        vector<ClosureTemplateEntry>& entries = closureTemplates[B];
+        for (size_t p = 0; p < productions.size(); p++) {
+            auto it = propagates.find(productions[p].left);
+            if (it == propagates.end()) continue;
+            ClosureTemplateEntry entry;
+            entry.prodIndex = p;
+            entry.spontaneous = spontaneous[productions[p].left];
+            entry.propagates = it->second;
+            entries.push_back(entry);
         }
     }
+}
+
+// 用闭包模板求核心项的闭包：每个核心项只需一次并集运算，无需迭代
+set<LR1Item> LR1Parser::computeClosure(const set<LR1Item>& kernel) {
+    set<LR1Item> result = kernel;
+
+    for (const LR1Item& item : kernel) {
+        const Production& prod = productions[item.prodIndex];
+
+        // 如果是ε产生式或点已在最后，跳过
+        if (prod.right[0] == "ε" || item.dotPos >= (int)prod.right.size()) {
+            continue;
+        }
 
+        const string& B = prod.right[item.dotPos];  // 点后面的符号
+        auto tpl = closureTemplates.find(B);
+        if (tpl == closureTemplates.end()) continue;
+
+        // L = FIRST(βa)
+        const set<string>& firstBeta = suffixFirst[item.prodIndex][item.dotPos + 1];
+        set<string> lookaheads;
+        for (const string& f : firstBeta) {
+            if (f != "ε") lookaheads.insert(f);
+        }
+        if (firstBeta.find("ε") != firstBeta.end()) {
+            lookaheads.insert(item.lookahead);
+        }
+
+        for (const ClosureTemplateEntry& entry : tpl->second) {
+            for (const string& b : entry.spontaneous) {
+                result.insert(LR1Item(entry.prodIndex, 0, b));
+            }
+            if (entry.propagates) {
+                for (const string& b : lookaheads) {
+                    result.insert(LR1Item(entry.prodIndex, 0, b));
+                }
+            }
+        }
+    }
+
+    itemsCreated += result.size() - kernel.size();
     return result;
 }
 
-// GOTO
-set<LR1Item> LR1Parser::goTo(const set<LR1Item>& items, const string& symbol) {
+// 查闭包缓存，未命中时求闭包并存入；可被多个线程同时调用
+KernelTable::Entry* LR1Parser::closeKernel(const set<LR1Item>& kernel) {
+    closureCalls++;
+
+    bool inserted;
+    KernelTable::Entry* entry = kernels.findOrInsert(kernel, inserted);
+    if (inserted) {
+        entry->items = computeClosure(kernel);
+        entry->ready = true;
+    }
+    else {
+        closureHits++;
+    }
+    return entry;
+}
+
+// 求闭包
+set<LR1Item> LR1Parser::closure(const set<LR1Item>& items) {
+    if (items.empty()) return items;
+
+    KernelTable::Entry* entry = closeKernel(items);
+    while (!entry->ready) {
+        this_thread::yield();   // 其他线程正在求同一核心项的闭包
+    }
+    return entry->items;
+}
+
+// GOTO的核心项（未求闭包）
+set<LR1Item> LR1Parser::gotoKernel(const set<LR1Item>& items, const string& symbol) {
     set<LR1Item> result;
 
     for (const LR1Item& item : items) {
         const Production& prod = productions[item.prodIndex];
 
-        // Ųʽƽ
-        if (prod.right[0] == "") continue;
+        // ε产生式不移进
+        if (prod.right[0] == "ε") continue;
 
-        // symbol
+        // 如果点后面是symbol
         if (item.dotPos < (int)prod.right.size() && prod.right[item.dotPos] == symbol) {
             LR1Item newItem(item.prodIndex, item.dotPos + 1, item.lookahead);
             result.insert(newItem);
         }
     }
+    itemsCreated += result.size();
 
-    return closure(result);
+    return result;
 }
 
-// ״̬
-int LR1Parser::findState(const set<LR1Item>& items) {
-    for (size_t i = 0; i < states.size(); i++) {
-        if (states[i] == items) return i;
-    }
-    return -1;
+// GOTO函数
+set<LR1Item> LR1Parser::goTo(const set<LR1Item>& items, const string& symbol) {
+    return closure(gotoKernel(items, symbol));
 }
 
-// Ŀ
+// 构造项目集族
+// 按层并行：同一层（frontier）各状态的GOTO互不依赖，由线程池并行求出，
+// 再按 (状态号, 符号) 的固定顺序串行编号，保证同一文法得到完全相同的分析表
 void LR1Parser::buildStates() {
     states.clear();
+    transitions.clear();
+    kernels.clear();
 
-    // ʼ״̬
+    // 初始状态
     set<LR1Item> initItems;
     initItems.insert(LR1Item(0, 0, "#"));
-    states.push_back(closure(initItems));
+    KernelTable::Entry* initEntry = closeKernel(initItems);
+    initEntry->state = 0;
+    states.push_back(initEntry->items);
+    transitions.push_back(map<string, int>());
 
-    // ķ
-    set<string> allSymbols;
+    // 所有文法符号
+    set<string> symbolSet;
     for (const string& t : terminals) {
-        if (t != "#") allSymbols.insert(t);
+        if (t != "#") symbolSet.insert(t);
     }
     for (const string& nt : nonTerminals) {
-        if (nt != "S'") allSymbols.insert(nt);
+        if (nt != startSymbol) symbolSet.insert(nt);
     }
-
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        size_t stateCount = states.size();
-
-        for (size_t i = 0; i < stateCount; i++) {
-            for (const string& X : allSymbols) {
-                set<LR1Item> gotoIX = goTo(states[i], X);
-
-                if (!gotoIX.empty() && findState(gotoIX) == -1) {
-                    states.push_back(gotoIX);
-                    changed = true;
-                }
+    vector<string> allSymbols(symbolSet.begin(), symbolSet.end());
+    size_t symbolCount = allSymbols.size();
+
+    ThreadPool pool(buildThreads);
+    stats.buildThreads = pool.size();
+
+    vector<int> frontier = { 0 };
+    while (!frontier.empty()) {
+        vector<KernelTable::Entry*> targets(frontier.size() * symbolCount, nullptr);
+
+        // 并行：求核心项，经闭包缓存去重，只有首次出现的核心项才求闭包
+        pool.parallelFor(targets.size(), [&](size_t k) {
+            const set<LR1Item>& from = states[frontier[k / symbolCount]];
+            set<LR1Item> kernel = gotoKernel(from, allSymbols[k % symbolCount]);
+            if (kernel.empty()) return;
+            targets[k] = closeKernel(kernel);
+        });
+
+        // 串行：按发现顺序编号新状态并记录转移
+        vector<int> next;
+        for (size_t k = 0; k < targets.size(); k++) {
+            KernelTable::Entry* entry = targets[k];
+            if (entry == nullptr) continue;
+
+            if (entry->state == -1) {
+                entry->state = states.size();
+                states.push_back(entry->items);
+                transitions.push_back(map<string, int>());
+                next.push_back(entry->state);
             }
+            transitions[frontier[k / symbolCount]][allSymbols[k % symbolCount]] = entry->state;
         }
+        frontier.swap(next);
     }
 }
 
-// 
+// 构造分析表
 void LR1Parser::buildTable() {
-    actionTable.clear();
-    gotoTable.clear();
+    size_t T = terminalOrder.size();
+    size_t N = nonTerminalOrder.size();
+    stateCount = states.size();
+    actionTable.assign(stateCount * T, ACTION_ERROR);
+    gotoTable.assign(stateCount * N, -1);
+
+    stats.shiftReduceConflicts = 0;
+    stats.reduceReduceConflicts = 0;
+    stats.precedenceResolved = 0;
+    vector<bool> blocked;
 
     for (size_t i = 0; i < states.size(); i++) {
+        int* row = &actionTable[i * T];
+        blocked.assign(T, false);
+
+        // 先填移进和接受，再逐个填归约，冲突在填归约时统一处理
         for (const LR1Item& item : states[i]) {
             const Production& prod = productions[item.prodIndex];
 
-            // 1: [A  a, b]aսACTION[i,a] = shift j
-            if (prod.right[0] != "" && item.dotPos < (int)prod.right.size()) {
-                string a = prod.right[item.dotPos];
+            // 情况1: [A → α·aβ, b]，a是终结符，ACTION[i,a] = shift j
+            if (prod.right[0] != "ε" && item.dotPos < (int)prod.right.size()) {
+                const string& a = prod.right[item.dotPos];
                 if (isTerminal(a)) {
-                    set<LR1Item> gotoIa = goTo(states[i], a);
-                    int j = findState(gotoIa);
-                    if (j != -1) {
-                        actionTable[{i, a}] = "s" + to_string(j);
+                    auto it = transitions[i].find(a);
+                    if (it != transitions[i].end()) {
+                        row[terminalIds[a]] = it->second + 1;
                     }
                 }
             }
 
-            // 2: [A  , a]  A  S'ACTION[i,a] = reduce j
-            if ((prod.right[0] == "" || item.dotPos == (int)prod.right.size()) &&
-                prod.left != "S'") {
-                actionTable[{i, item.lookahead}] = "r" + to_string(item.prodIndex);
+            // 情况3: [S' → S·, #]，ACTION[i,#] = acc
+            if (item.prodIndex == 0 && item.dotPos == 1 && item.lookahead == "#") {
+                row[terminalIds["#"]] = ACTION_ACCEPT;
             }
+        }
 
-            // 3: [S'  S, #]ACTION[i,#] = acc
-            if (item.prodIndex == 0 && item.dotPos == 1 && item.lookahead == "#") {
-                actionTable[{i, "#"}] = "acc";
+        for (const LR1Item& item : states[i]) {
+            const Production& prod = productions[item.prodIndex];
+
+            // 情况2: [A → α·, a] 且 A ≠ S'，ACTION[i,a] = reduce j
+            if ((prod.right[0] == "ε" || item.dotPos == (int)prod.right.size()) &&
+                prod.left != startSymbol) {
+                int t = terminalIds[item.lookahead];
+                row[t] = resolveConflict(i, t, row[t], -(item.prodIndex + 1), blocked);
+            }
+        }
+
+        // GOTO表
+        for (const auto& tr : transitions[i]) {
+            auto it = nonTerminalIds.find(tr.first);
+            if (it != nonTerminalIds.end()) {
+                gotoTable[i * N + it->second] = tr.second;
+            }
+        }
+    }
+
+    if (stats.shiftReduceConflicts + stats.reduceReduceConflicts > 0) {
+        progress << "文法不是LR(1)的：移进/归约冲突 " << stats.shiftReduceConflicts
+             << " 个，归约/归约冲突 " << stats.reduceReduceConflicts << " 个" << endl;
+    }
+    if (stats.precedenceResolved > 0) {
+        progress << "按优先级和结合性消解冲突 " << stats.precedenceResolved << " 个" << endl;
+    }
+
+    stats.actionEntries = actionTable.size() - count(actionTable.begin(), actionTable.end(), ACTION_ERROR);
+    stats.gotoEntries = gotoTable.size() - count(gotoTable.begin(), gotoTable.end(), -1);
+}
+
+// 向ACTION[state,terminal]填入归约reduce，返回消解后的表项
+// 移进/归约：两边都有优先级时取高者，同级按结合性（左结合归约，右结合移进，非结合报错）；
+// 否则按惯例取移进。归约/归约：取编号小的产生式。未能用优先级消解的冲突计数并报告
+int LR1Parser::resolveConflict(int state, int terminal, int current, int reduce, vector<bool>& blocked) {
+    if (blocked[terminal]) return ACTION_ERROR;
+    if (current == ACTION_ERROR || current == reduce) return reduce;
+
+    const string& a = terminalOrder[terminal];
+    int p = -reduce - 1;
+
+    if (current < 0) {
+        int q = -current - 1;
+        stats.reduceReduceConflicts++;
+        progress << "  状态 " << state << " 遇 " << a << "：归约/归约冲突，r" << q << " 与 r" << p
+             << "，取 " << productionToString(min(p, q)) << endl;
+        return -(min(p, q) + 1);
+    }
+
+    auto it = terminalPrec.find(a);
+    if (it != terminalPrec.end() && productionPrec[p] >= 0) {
+        stats.precedenceResolved++;
+        int tokenPrec = it->second;
+        if (productionPrec[p] > tokenPrec) return reduce;
+        if (productionPrec[p] < tokenPrec) return current;
+        switch (precedenceLevels[tokenPrec].first) {
+        case ASSOC_LEFT: return reduce;
+        case ASSOC_RIGHT: return current;
+        default:
+            blocked[terminal] = true;
+            return ACTION_ERROR;
+        }
+    }
+
+    stats.shiftReduceConflicts++;
+    progress << "  状态 " << state << " 遇 " << a << "：移进/归约冲突，取移进 s" << current - 1
+         << "，舍弃 " << productionToString(p) << endl;
+    return current;
+}
+
+// 无标签、右部为单个非终结符的产生式，归约时只传递语义值
+bool LR1Parser::isUnitProduction(int index) const {
+    const Production& prod = productions[index];
+    return index != 0 && prod.len == 1 && prod.label.empty() && nonTerminalIds.count(prod.right[0]) > 0;
+}
+
+// 构造链式GOTO表：从状态s经A转到q后，若向前看a时q按单产生式 B → A 归约，
+// 弹出q后回到s再经B转移，如此直到不再是单产生式归约。结果只取决于(s, A, a)，
+// 分析时一次查表即可跳过整条单产生式链，栈内容与逐步归约完全相同。
+// 规范LR(1)表只在合法的向前看上归约，所以出错时所处的状态和报告的期望单词不变
+void LR1Parser::buildUnitChains() {
+    size_t T = terminalOrder.size();
+    size_t N = nonTerminalOrder.size();
+
+    stateSymbol.assign(stateCount, -1);
+    for (int s = 0; s < stateCount; s++) {
+        for (size_t nt = 0; nt < N; nt++) {
+            int g = gotoAt(s, nt);
+            if (g >= 0) stateSymbol[g] = nt;
+        }
+    }
+
+    // 大多数(s, A)没有短路，稠密的 状态×非终结符×终结符 表几乎全是普通GOTO，只记录不同的表项
+    chainStart.assign((size_t)stateCount * N + 1, 0);
+    chainCells.clear();
+    for (int s = 0; s < stateCount; s++) {
+        for (size_t nt = 0; nt < N; nt++) {
+            size_t cell = (size_t)s * N + nt;
+            chainStart[cell] = chainCells.size();
+            int g = gotoAt(s, nt);
+            if (g < 0) continue;
+            for (size_t a = 0; a < T; a++) {
+                int q = g;
+                // 单产生式不会成环（否则文法二义），链长不超过非终结符数
+                for (size_t k = 0; k < N; k++) {
+                    int action = actionAt(q, a);
+                    if (action >= 0 || action == ACTION_ACCEPT || !isUnitProduction(-action - 1)) break;
+                    int next = gotoAt(s, productionLhs[-action - 1]);
+                    if (next < 0) break;
+                    q = next;
+                }
+                if (q != g) chainCells.push_back(make_pair((int)a, q));
             }
         }
+    }
+    chainStart.back() = chainCells.size();
+    stats.unitChainEntries = (int)chainCells.size();
+}
+
+// ==================== 分析表缓存 ====================
+// 文件格式：魔数"LR1T"、版本、文法哈希、状态数、终结符数、非终结符数，
+// 随后依次为ACTION表和GOTO表（int32，按状态行存放）
+static const char TABLE_CACHE_MAGIC[4] = { 'L', 'R', '1', 'T' };
+static const int TABLE_CACHE_VERSION = 1;
+
+string LR1Parser::cacheFilePath() const {
+    return cacheDir + "/.lr1_" + grammarHash + ".tbl";
+}
+
+bool LR1Parser::loadTableCache() {
+    if (cacheDir.empty()) return false;
+
+    ifstream file(cacheFilePath(), ios::binary);
+    if (!file.is_open()) return false;
+
+    char magic[4];
+    int header[5];      // 版本、哈希高32位、哈希低32位、状态数、终结符数
+    int ntCount;
+    file.read(magic, 4);
+    file.read((char*)header, sizeof(header));
+    file.read((char*)&ntCount, sizeof(ntCount));
+    if (!file || memcmp(magic, TABLE_CACHE_MAGIC, 4) != 0 || header[0] != TABLE_CACHE_VERSION ||
+        header[4] != (int)terminalOrder.size() || ntCount != (int)nonTerminalOrder.size() ||
+        header[3] <= 0) {
+        return false;
+    }
+
+    unsigned long long h = strtoull(grammarHash.c_str(), nullptr, 16);
+    if ((unsigned)header[1] != (unsigned)(h >> 32) || (unsigned)header[2] != (unsigned)h) {
+        return false;
+    }
+
+    stateCount = header[3];
+    actionTable.assign(stateCount * terminalOrder.size(), ACTION_ERROR);
+    gotoTable.assign(stateCount * nonTerminalOrder.size(), -1);
+    file.read((char*)actionTable.data(), actionTable.size() * sizeof(int));
+    file.read((char*)gotoTable.data(), gotoTable.size() * sizeof(int));
+    if (!file) {
+        stateCount = 0;
+        return false;
+    }
+
+    states.clear();
+    transitions.clear();
+    stats.actionEntries = actionTable.size() - count(actionTable.begin(), actionTable.end(), ACTION_ERROR);
+    stats.gotoEntries = gotoTable.size() - count(gotoTable.begin(), gotoTable.end(), -1);
+    return true;
+}
+
+void LR1Parser::saveTableCache() {
+    if (cacheDir.empty()) return;
+
+    // 先写临时文件再改名，避免其他进程读到写了一半的缓存
+    string path = cacheFilePath();
+    string tmpPath = path + ".tmp";
+    {
+        ofstream file(tmpPath, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            err << "无法写入分析表缓存：" << path << endl;
+            return;
+        }
+
+        unsigned long long h = strtoull(grammarHash.c_str(), nullptr, 16);
+        int header[5] = { TABLE_CACHE_VERSION, (int)(unsigned)(h >> 32), (int)(unsigned)h,
+                          stateCount, (int)terminalOrder.size() };
+        int ntCount = nonTerminalOrder.size();
+        file.write(TABLE_CACHE_MAGIC, 4);
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)&ntCount, sizeof(ntCount));
+        file.write((const char*)actionTable.data(), actionTable.size() * sizeof(int));
+        file.write((const char*)gotoTable.data(), gotoTable.size() * sizeof(int));
+        if (!file) {
+            err << "无法写入分析表缓存：" << path << endl;
+            return;
+        }
+    }
+    remove(path.c_str());
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+    }
+}
+
+// ==================== 按剖析数据重排 ====================
+
+// 按表项在内存中的位置（行优先，int32，假定表从缓存行边界开始）统计：
+// 被访问过的缓存行数、覆盖99%访问所需的最少缓存行数、被访问过的页数
+struct TableLocality {
+    int lines;
+    int hotLines;
+    int pages;
+};
+
+static TableLocality measureLocality(const vector<uint64_t>& cells) {
+    const size_t CELLS_PER_LINE = 64 / sizeof(int);
+    const size_t CELLS_PER_PAGE = 4096 / sizeof(int);
+    vector<uint64_t> lines((cells.size() + CELLS_PER_LINE - 1) / CELLS_PER_LINE, 0);
+    set<size_t> pages;
+    uint64_t total = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (cells[i] == 0) continue;
+        lines[i / CELLS_PER_LINE] += cells[i];
+        pages.insert(i / CELLS_PER_PAGE);
+        total += cells[i];
+    }
+
+    TableLocality result = { 0, 0, (int)pages.size() };
+    sort(lines.begin(), lines.end(), greater<uint64_t>());
+    uint64_t covered = 0;
+    for (uint64_t c : lines) {
+        if (c == 0) break;
+        result.lines++;
+        if (covered * 100 < total * 99) {
+            covered += c;
+            result.hotLines++;
+        }
+    }
+    return result;
+}
+
+// 把两张表的访问次数按当前排列展开为一个序列（ACTION表在前）
+static vector<uint64_t> tableCells(const ParseProfile& profile, const vector<int>& stateOrder,
+    const vector<int>& termOrder, const vector<int>& ntOrder) {
+    vector<uint64_t> cells;
+    cells.reserve(stateOrder.size() * (termOrder.size() + ntOrder.size()));
+    for (int s : stateOrder) {
+        for (int t : termOrder) cells.push_back(profile.actionCount(s, t));
+    }
+    // GOTO表紧接在ACTION表之后，按行补齐到缓存行边界
+    while (cells.size() % (64 / sizeof(int)) != 0) cells.push_back(0);
+    for (int s : stateOrder) {
+        for (int n : ntOrder) cells.push_back(profile.gotoCount(s, n));
+    }
+    return cells;
+}
+
+// 初始状态仍为0号，其余状态按访问次数从高到低编号；终结符和非终结符列也按访问次数排列。
+// 只改变编号，表的内容（以及分析结果）不变
+bool LR1Parser::applyProfile() {
+    ParseProfile profile;
+    string error;
+    if (!profile.load(*this, profilePath, error)) {
+        err << error << endl;
+        return false;
+    }
+
+    size_t T = terminalOrder.size();
+    size_t N = nonTerminalOrder.size();
+    vector<uint64_t> stateHeat(stateCount, 0), termHeat(T, 0), ntHeat(N, 0);
+    for (int s = 0; s < stateCount; s++) {
+        for (size_t t = 0; t < T; t++) {
+            stateHeat[s] += profile.actionCount(s, t);
+            termHeat[t] += profile.actionCount(s, t);
+        }
+        for (size_t n = 0; n < N; n++) {
+            stateHeat[s] += profile.gotoCount(s, n);
+            ntHeat[n] += profile.gotoCount(s, n);
+        }
+    }
 
-        // GOTO
-        for (const string& A : nonTerminals) {
-            if (A == "S'") continue;
-            set<LR1Item> gotoIA = goTo(states[i], A);
-            int j = findState(gotoIA);
-            if (j != -1) {
-                gotoTable[{i, A}] = j;
+    // xxxOrder[新编号] = 原编号
+    auto hotFirst = [](const vector<uint64_t>& heat, size_t fixed) {
+        vector<int> order(heat.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        stable_sort(order.begin() + fixed, order.end(), [&](int a, int b) { return heat[a] > heat[b]; });
+        return order;
+    };
+    vector<int> stateOrder = hotFirst(stateHeat, 1);
+    vector<int> termOrder = hotFirst(termHeat, 0);
+    vector<int> ntOrder = hotFirst(ntHeat, 0);
+
+    vector<int> identityStates = hotFirst(vector<uint64_t>(stateCount, 0), 0);
+    vector<int> identityTerms = hotFirst(vector<uint64_t>(T, 0), 0);
+    vector<int> identityNts = hotFirst(vector<uint64_t>(N, 0), 0);
+    TableLocality before = measureLocality(tableCells(profile, identityStates, identityTerms, identityNts));
+    TableLocality after = measureLocality(tableCells(profile, stateOrder, termOrder, ntOrder));
+
+    vector<int> newState(stateCount), newNt(N);
+    for (int i = 0; i < stateCount; i++) newState[stateOrder[i]] = i;
+    for (size_t i = 0; i < N; i++) newNt[ntOrder[i]] = i;
+
+    vector<int> action(actionTable.size()), go(gotoTable.size());
+    for (int s = 0; s < stateCount; s++) {
+        int from = stateOrder[s];
+        for (size_t t = 0; t < T; t++) {
+            int a = actionTable[from * T + termOrder[t]];
+            action[s * T + t] = a > 0 ? newState[a - 1] + 1 : a;
+        }
+        for (size_t n = 0; n < N; n++) {
+            int g = gotoTable[from * N + ntOrder[n]];
+            go[s * N + n] = g >= 0 ? newState[g] : -1;
+        }
+    }
+    actionTable.swap(action);
+    gotoTable.swap(go);
+
+    // 项目集族只在本次构造时存在（从缓存加载时为空）
+    if (!states.empty()) {
+        vector<set<LR1Item>> oldStates;
+        vector<map<string, int>> oldTransitions;
+        oldStates.swap(states);
+        oldTransitions.swap(transitions);
+        for (int s = 0; s < stateCount; s++) {
+            states.push_back(move(oldStates[stateOrder[s]]));
+            transitions.push_back(map<string, int>());
+            for (const auto& tr : oldTransitions[stateOrder[s]]) {
+                transitions.back()[tr.first] = newState[tr.second];
             }
         }
     }
+
+    vector<string> oldTerms, oldNts;
+    oldTerms.swap(terminalOrder);
+    oldNts.swap(nonTerminalOrder);
+    for (size_t t = 0; t < T; t++) {
+        terminalOrder.push_back(oldTerms[termOrder[t]]);
+        terminalIds[terminalOrder.back()] = t;
+    }
+    for (size_t n = 0; n < N; n++) {
+        nonTerminalOrder.push_back(oldNts[ntOrder[n]]);
+        nonTerminalIds[nonTerminalOrder.back()] = n;
+    }
+    for (int& lhs : productionLhs) lhs = newNt[lhs];
+
+    stateOrigin = stateOrder;
+    terminalOrigin = termOrder;
+
+    // 排列方式的哈希，区分同一文法的不同排列（生成的直接编码分析器依赖终结符编号）
+    unsigned long long h = 14695981039346656037ull;
+    auto mix = [&h](int v) { h ^= (unsigned)v; h *= 1099511628211ull; };
+    for (int v : stateOrder) mix(v);
+    for (int v : termOrder) mix(v);
+    for (int v : ntOrder) mix(v);
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%016llx", h);
+    layoutHash = grammarHash + "-" + buf;
+
+    stats.renumbered = true;
+    stats.hotLinesBefore = before.hotLines;
+    stats.hotLinesAfter = after.hotLines;
+    progress << "按剖析数据重排状态和列（" << profile.total() << " 次表访问）：" << endl;
+    progress << "  访问过的缓存行 " << before.lines << " → " << after.lines
+        << "，覆盖99%访问的缓存行 " << before.hotLines << " → " << after.hotLines
+        << "，访问过的页 " << before.pages << " → " << after.pages << endl;
+    return true;
 }
 
-// ʼ
-void LR1Parser::init() {
-    cout << "ڳʼķ..." << endl;
-    initGrammar();
+// 初始化
+bool LR1Parser::init() {
+    stats = TableStats();
+    closureCalls = 0;
+    closureHits = 0;
+    itemsCreated = 0;
+    Stopwatch timer;
+    LR1_ALLOC_SCOPE(ALLOC_GRAMMAR);
+
+    progress << "正在初始化文法..." << endl;
+    if (!initGrammar()) {
+        return false;
+    }
+    stats.grammarMs = timer.elapsedMs();
 
-    cout << "ڼFIRST..." << endl;
+    timer.restart();
+    LR1_ALLOC_NEXT(ALLOC_FIRST_FOLLOW);
+    progress << "正在计算FIRST集..." << endl;
     computeFirstSets();
 
-    cout << "ڼFOLLOW..." << endl;
+    progress << "正在计算FOLLOW集..." << endl;
     computeFollowSets();
+    stats.firstFollowMs = timer.elapsedMs();
+
+    timer.restart();
+    LR1_ALLOC_NEXT(ALLOC_TABLE);
+    if (loadTableCache()) {
+        stats.fromCache = true;
+        stats.tableMs = timer.elapsedMs();
+        progress << "已从缓存加载LR(1)分析表：" << cacheFilePath() << endl;
+    }
+    else {
+        LR1_ALLOC_NEXT(ALLOC_STATES);
+        buildClosureTemplates();
+        progress << "正在构造LR(1)项目集族..." << endl;
+        buildStates();
+        stats.statesMs = timer.elapsedMs();
+
+        timer.restart();
+        LR1_ALLOC_NEXT(ALLOC_TABLE);
+        progress << "正在构造LR(1)分析表..." << endl;
+        buildTable();
+        saveTableCache();
+        stats.tableMs = timer.elapsedMs();
+        stats.closureCalls = closureCalls;
+        stats.closureHits = closureHits;
+        stats.itemsCreated = itemsCreated;
+    }
+    stats.states = stateCount;
+
+    // 缓存中保存的总是未重排的表
+    stateOrigin.clear();
+    terminalOrigin.clear();
+    layoutHash = grammarHash;
+    if (!profilePath.empty() && !applyProfile()) {
+        return false;
+    }
 
-    cout << "ڹLR(1)Ŀ..." << endl;
-    buildStates();
+    chainStart.clear();
+    chainCells.clear();
+    stateSymbol.clear();
+    stats.unitChainEntries = -1;
+    if (unitElimination) {
+        buildUnitChains();
+        layoutHash += "-unit";
+        progress << "单产生式短路：链式GOTO表项 " << stats.unitChainEntries << " 个" << endl;
+    }
 
-    cout << "ڹLR(1)..." << endl;
-    buildTable();
+    progress << "初始化完成！共 " << stateCount << " 个状态" << endl;
+    if (!stats.fromCache) {
+        progress << "闭包缓存：调用 " << stats.closureCalls << " 次，命中 " << stats.closureHits << " 次" << endl;
+    }
+    return true;
+}
+
+// 终结符编号，不是终结符时返回-1
+int LR1Parser::terminalId(const string& symbol) const {
+    auto it = terminalIds.find(symbol);
+    return it != terminalIds.end() ? it->second : -1;
+}
 
-    cout << "ʼɣ " << states.size() << " ״̬" << endl;
+int LR1Parser::nonTerminalId(const string& symbol) const {
+    auto it = nonTerminalIds.find(symbol);
+    return it != nonTerminalIds.end() ? it->second : -1;
 }
 
-// ȡACTION
+// ACTION表项的文本形式：s5、r3、acc，出错为空串
+string LR1Parser::actionToString(int action) {
+    if (action == ACTION_ERROR) return "";
+    if (action == ACTION_ACCEPT) return "acc";
+    if (action > 0) return "s" + to_string(action - 1);
+    return "r" + to_string(-action - 1);
+}
+
+// 获取ACTION
 string LR1Parser::getAction(int state, const string& symbol) {
-    auto it = actionTable.find({ state, symbol });
-    if (it != actionTable.end()) {
-        return it->second;
-    }
-    return "";
+    int t = terminalId(symbol);
+    if (state < 0 || state >= stateCount || t < 0) return "";
+    return actionToString(actionAt(state, t));
 }
 
-// ȡGOTO
+// 获取GOTO
 int LR1Parser::getGoto(int state, const string& symbol) {
-    auto it = gotoTable.find({ state, symbol });
-    if (it != gotoTable.end()) {
-        return it->second;
+    auto it = nonTerminalIds.find(symbol);
+    if (state < 0 || state >= stateCount || it == nonTerminalIds.end()) return -1;
+    return gotoAt(state, it->second);
+}
+
+// 产生式文本，如 "E -> E + T"
+string LR1Parser::productionToString(int index) const {
+    const Production& prod = productions[index];
+    string result = prod.left + " ->";
+    for (const string& sym : prod.right) {
+        result += " " + sym;
     }
-    return -1;
+    return result;
 }
 
-// ӡķ
+// 打印文法
 void LR1Parser::printGrammar() {
-    cout << "\n==================== ķʽ ====================" << endl;
+    cout << "\n==================== 文法产生式 ====================" << endl;
     for (size_t i = 0; i < productions.size(); i++) {
-        cout << "(" << i << ") " << productions[i].left << "  ";
+        cout << "(" << i << ") " << productions[i].left << " → ";
         for (size_t j = 0; j < productions[i].right.size(); j++) {
             cout << productions[i].right[j];
             if (j < productions[i].right.size() - 1) cout << " ";
@@ -445,11 +1257,10 @@ void LR1Parser::printGrammar() {
     cout << "===================================================\n" << endl;
 }
 
-// ӡFIRST
+// 打印FIRST集
 void LR1Parser::printFirstSets() {
-    cout << "\n==================== FIRST ====================" << endl;
-    vector<string> order = { "S'", "S", "L", "C", "E", "T", "F", "M", "N" };
-    for (const string& nt : order) {
+    cout << "\n==================== FIRST集 ====================" << endl;
+    for (const string& nt : nonTerminalOrder) {
         cout << "FIRST(" << nt << ") = { ";
         bool first = true;
         for (const string& f : firstSet[nt]) {
@@ -462,11 +1273,10 @@ void LR1Parser::printFirstSets() {
     cout << "=================================================\n" << endl;
 }
 
-// ӡFOLLOW
+// 打印FOLLOW集
 void LR1Parser::printFollowSets() {
-    cout << "\n==================== FOLLOW ====================" << endl;
-    vector<string> order = { "S'", "S", "L", "C", "E", "T", "F", "M", "N" };
-    for (const string& nt : order) {
+    cout << "\n==================== FOLLOW集 ====================" << endl;
+    for (const string& nt : nonTerminalOrder) {
         cout << "FOLLOW(" << nt << ") = { ";
         bool first = true;
         for (const string& f : followSet[nt]) {
@@ -479,24 +1289,27 @@ void LR1Parser::printFollowSets() {
     cout << "==================================================\n" << endl;
 }
 
-// ӡĿ
+// 打印项目集
 void LR1Parser::printStates() {
-    cout << "\n==================== LR(1)Ŀ ====================" << endl;
+    cout << "\n==================== LR(1)项目集族 ====================" << endl;
+    if (stats.fromCache) {
+        cout << "（分析表从缓存加载，未构造项目集族）" << endl;
+    }
     for (size_t i = 0; i < states.size(); i++) {
         cout << "I" << i << ":" << endl;
         for (const LR1Item& item : states[i]) {
             const Production& prod = productions[item.prodIndex];
-            cout << "  [" << prod.left << "  ";
+            cout << "  [" << prod.left << " → ";
 
-            if (prod.right[0] == "") {
-                cout << "";
+            if (prod.right[0] == "ε") {
+                cout << "·";
             }
             else {
                 for (size_t j = 0; j < prod.right.size(); j++) {
-                    if ((int)j == item.dotPos) cout << "";
+                    if ((int)j == item.dotPos) cout << "·";
                     cout << prod.right[j] << " ";
                 }
-                if (item.dotPos == (int)prod.right.size()) cout << "";
+                if (item.dotPos == (int)prod.right.size()) cout << "·";
             }
 
             cout << ", " << item.lookahead << "]" << endl;
@@ -506,16 +1319,18 @@ void LR1Parser::printStates() {
     cout << "======================================================\n" << endl;
 }
 
-// ӡ
+// 打印分析表
 void LR1Parser::printTable() {
-    cout << "\n==================== LR(1) ====================" << endl;
+    cout << "\n==================== LR(1)分析表 ====================" << endl;
 
-    vector<string> termList = { "id", "num", "if", "else", "=", "rop", "+", "-", "*", "/",
-                               "(", ")", "{", "}", "#" };
-    vector<string> ntList = { "S", "L", "C", "E", "T", "F", "M", "N" };
+    const vector<string>& termList = terminalOrder;
+    vector<string> ntList;
+    for (const string& nt : nonTerminalOrder) {
+        if (nt != startSymbol) ntList.push_back(nt);
+    }
 
-    // ͷ
-    cout << setw(6) << "״̬" << " |";
+    // 表头
+    cout << setw(6) << "状态" << " |";
     for (const string& t : termList) {
         cout << setw(5) << t;
     }
@@ -527,8 +1342,8 @@ void LR1Parser::printTable() {
 
     cout << string(6 + 1 + termList.size() * 5 + 1 + ntList.size() * 4 + 2, '-') << endl;
 
-    // ÿһ
-    for (size_t i = 0; i < states.size(); i++) {
+    // 每一行
+    for (int i = 0; i < stateCount; i++) {
         cout << setw(6) << i << " |";
 
         for (const string& t : termList) {
@@ -1,58 +1,204 @@
-#pragma once
-#ifndef LR1_PARSER_H
-#define LR1_PARSER_H
-
-#include "common.h"
-
-class LR1Parser {
-private:
-    // ķ
-    vector<Production> productions;
-    set<string> terminals;
-    set<string> nonTerminals;
-    string startSymbol;
-
-    // FIRSTFOLLOW
-    map<string, set<string>> firstSet;
-    map<string, set<string>> followSet;
-
-    // LR(1)Ŀ
-    vector<set<LR1Item>> states;
-
-    // ACTIONGOTO
-    map<pair<int, string>, string> actionTable;
-    map<pair<int, string>, int> gotoTable;
-
-    // 
-    void initGrammar();
-    void computeFirstSets();
-    void computeFollowSets();
-    set<string> getFirstOfSequence(const vector<string>& seq, size_t start);
-
-    set<LR1Item> closure(const set<LR1Item>& items);
-    set<LR1Item> goTo(const set<LR1Item>& items, const string& symbol);
-    int findState(const set<LR1Item>& items);
-    void buildStates();
-    void buildTable();
-
-    bool isTerminal(const string& s);
-    bool isNonTerminal(const string& s);
-
-public:
-    LR1Parser();
-    void init();
-
-    // ȡ
-    string getAction(int state, const string& symbol);
-    int getGoto(int state, const string& symbol);
-    const Production& getProduction(int index) const { return productions[index]; }
-
-    // ӡ
-    void printGrammar();
-    void printFirstSets();
-    void printFollowSets();
-    void printStates();
-    void printTable();
-};
-
-#endif
+#pragma once
+#ifndef LR1_PARSER_H
+#define LR1_PARSER_H
+
+#include "common.h"
+#include "stats.h"
+#include "alloc_stats.h"
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+// 项目集哈希（用于按核心项去重）
+struct ItemSetHash {
+    size_t operator()(const set<LR1Item>& items) const;
+};
+
+// ==================== 核心项表 ====================
+// 以核心项为键的分片并发哈希表，多个线程构造状态时用于去重，同时作为闭包缓存
+class KernelTable {
+public:
+    struct Entry {
+        set<LR1Item> items;     // 核心项的闭包
+        int state;              // 状态编号，-1表示尚未编号
+        atomic<bool> ready;     // items是否已求出
+        Entry() : state(-1), ready(false) {}
+    };
+
+    // 查找核心项，不存在时插入新表项；inserted表示是否由本次调用插入
+    Entry* findOrInsert(const set<LR1Item>& kernel, bool& inserted);
+    void clear();
+
+private:
+    static const int SHARDS = 64;
+    struct Shard {
+        mutex lock;
+        unordered_map<set<LR1Item>, unique_ptr<Entry>, ItemSetHash> map;
+    };
+    Shard shards[SHARDS];
+};
+
+// ACTION表项编码：0为出错，正数j+1为移进到状态j，负数-(p+1)为按产生式p归约；
+// 按0号产生式（增广产生式）归约即为acc
+const int ACTION_ERROR = 0;
+const int ACTION_ACCEPT = -1;
+
+class LR1Parser {
+private:
+    // 文法
+    vector<Production> productions;
+    set<string> terminals;
+    set<string> nonTerminals;
+    vector<string> terminalOrder;       // 终结符编号顺序（也是打印顺序）
+    vector<string> nonTerminalOrder;    // 非终结符编号顺序
+    map<string, int> terminalIds;
+    map<string, int> nonTerminalIds;
+    vector<int> productionLhs;          // 产生式左部的非终结符编号
+    string startSymbol;
+    string grammarPath;                 // 文法文件，为空时使用内置文法
+    string grammarHash;                 // 规范化文法文本的哈希
+
+    // 优先级与结合性（%left / %right / %nonassoc），用于消解移进/归约冲突
+    enum Assoc { ASSOC_LEFT, ASSOC_RIGHT, ASSOC_NONASSOC };
+    vector<pair<Assoc, vector<string>>> precedenceLevels;   // 按声明顺序，越靠后优先级越高
+    map<string, int> terminalPrec;      // 终结符的优先级（precedenceLevels下标）
+    vector<int> productionPrec;         // 产生式的优先级，-1表示没有
+    vector<string> productionPrecToken; // %prec 指定的终结符，为空表示按最右终结符
+
+    // FIRST集和FOLLOW集
+    map<string, set<string>> firstSet;
+    map<string, set<string>> followSet;
+
+    // 闭包模板：closureTemplates[B] 为点在B前时闭包加入的所有产生式
+    struct ClosureTemplateEntry {
+        int prodIndex;
+        set<string> spontaneous;    // 自生的向前看符号
+        bool propagates;            // 是否再加入 FIRST(βa)
+    };
+    map<string, vector<ClosureTemplateEntry>> closureTemplates;
+    vector<vector<set<string>>> suffixFirst;    // suffixFirst[p][i] = FIRST(右部第i个符号起的串)
+
+    // LR(1)项目集族
+    vector<set<LR1Item>> states;
+    vector<map<string, int>> transitions;   // transitions[i][X] = GOTO(Ii, X)的状态号
+    KernelTable kernels;
+    int buildThreads;                       // 构造项目集族的线程数，0表示全部硬件线程
+
+    // ACTION和GOTO表（按状态行存放的稠密表）
+    int stateCount;
+    vector<int> actionTable;    // actionTable[state * 终结符数 + 终结符编号]
+    vector<int> gotoTable;      // gotoTable[state * 非终结符数 + 非终结符编号]，-1表示无
+    string cacheDir;            // 分析表缓存目录，为空（默认）时不使用缓存
+
+    // 按剖析数据重排（见 parse_profile.h）
+    string profilePath;         // 剖析文件，为空时不重排
+    vector<int> stateOrigin;    // stateOrigin[新编号] = 原编号，未重排时为空
+    vector<int> terminalOrigin; // 终结符的原编号，同上
+    string layoutHash;          // 文法哈希加上重排方式，标识表的具体排列
+
+    // 单产生式短路：无标签的 A → B 只传递语义值，GOTO后若紧接着按它归约，直接转到最终状态
+    bool unitElimination;
+    // 链式GOTO只存与普通GOTO不同的表项：(state, 非终结符)的表项为
+    // chainCells[chainStart[state * 非终结符数 + 非终结符] .. chainStart[同上 + 1])，按终结符排序
+    vector<size_t> chainStart;
+    vector<pair<int, int>> chainCells;     // (终结符, 链末状态)
+    vector<int> stateSymbol;    // 进入各状态的非终结符，由终结符或初态进入时为-1
+
+    // 构造过程的进度和文法错误分别写到这两个流，默认为标准输出和标准错误
+    ostream progress;
+    ostream err;
+
+    // 构造统计
+    TableStats stats;
+    atomic<long long> closureCalls;
+    atomic<long long> itemsCreated;
+    atomic<long long> closureHits;
+
+    // 辅助函数
+    bool initGrammar();
+    bool parseGrammar(const string& text, const string& origin);
+    string normalizedGrammar() const;
+    string cacheFilePath() const;
+    bool loadTableCache();
+    void saveTableCache();
+    void computeFirstSets();
+    void computeFollowSets();
+    set<string> getFirstOfSequence(const vector<string>& seq, size_t start);
+
+    void buildClosureTemplates();
+    set<LR1Item> computeClosure(const set<LR1Item>& kernel);
+    KernelTable::Entry* closeKernel(const set<LR1Item>& kernel);
+    set<LR1Item> closure(const set<LR1Item>& items);
+    set<LR1Item> gotoKernel(const set<LR1Item>& items, const string& symbol);
+    set<LR1Item> goTo(const set<LR1Item>& items, const string& symbol);
+    void buildStates();
+    void buildTable();
+    int resolveConflict(int state, int terminal, int current, int reduce, vector<bool>& blocked);
+    bool applyProfile();
+    bool isUnitProduction(int index) const;
+    void buildUnitChains();
+
+    bool isTerminal(const string& s);
+    bool isNonTerminal(const string& s);
+
+public:
+    LR1Parser();
+    bool init();
+    void setBuildThreads(int n) { buildThreads = n; }
+    void setGrammarFile(const string& path) { grammarPath = path; }
+    void setCacheDir(const string& dir) { cacheDir = dir; }
+    // 重定向构造过程的输出，nullptr表示丢弃；打印函数（print*）不受影响
+    void setStreams(streambuf* progressOut, streambuf* errorOut);
+    const string& getGrammarHash() const { return grammarHash; }
+    // 构造分析表后按剖析文件重排状态和列，热点表项集中到少数缓存行
+    void setProfileFile(const string& path) { profilePath = path; }
+    bool isRenumbered() const { return !stateOrigin.empty(); }
+    int originalState(int state) const { return stateOrigin.empty() ? state : stateOrigin[state]; }
+    int originalTerminal(int terminal) const { return terminalOrigin.empty() ? terminal : terminalOrigin[terminal]; }
+    const string& getLayoutHash() const { return layoutHash; }
+    // 在init时另外构造三维的链式GOTO表 f(s, A, a)，跳过不做语义工作的单产生式归约
+    void setUnitElimination(bool on) { unitElimination = on; }
+    bool hasUnitChains() const { return !chainStart.empty(); }
+
+    // 获取分析表
+    string getAction(int state, const string& symbol);
+    int getGoto(int state, const string& symbol);
+    int terminalId(const string& symbol) const;
+    int nonTerminalId(const string& symbol) const;
+    int terminalCount() const { return (int)terminalOrder.size(); }
+    const string& terminalName(int terminal) const { return terminalOrder[terminal]; }
+    int nonTerminalCount() const { return (int)nonTerminalOrder.size(); }
+    const string& nonTerminalName(int nonTerminal) const { return nonTerminalOrder[nonTerminal]; }
+    int getStateCount() const { return stateCount; }
+    int actionAt(int state, int terminal) const {
+        return actionTable[state * terminalOrder.size() + terminal];
+    }
+    int gotoAt(int state, int nonTerminal) const {
+        return gotoTable[state * nonTerminalOrder.size() + nonTerminal];
+    }
+    // 归约到nonTerminal后、向前看为terminal时最终进入的状态（含短路的单产生式）
+    int chainGotoAt(int state, int nonTerminal, int terminal) const {
+        size_t cell = (size_t)state * nonTerminalOrder.size() + nonTerminal;
+        auto first = chainCells.begin() + chainStart[cell];
+        auto last = chainCells.begin() + chainStart[cell + 1];
+        auto it = lower_bound(first, last, make_pair(terminal, -1));
+        return it != last && it->first == terminal ? it->second : gotoAt(state, nonTerminal);
+    }
+    int accessingNonTerminal(int state) const { return stateSymbol[state]; }
+    int productionLhsId(int index) const { return productionLhs[index]; }
+    static string actionToString(int action);
+    const Production& getProduction(int index) const { return productions[index]; }
+    int getProductionCount() const { return (int)productions.size(); }
+    string productionToString(int index) const;
+    const TableStats& getStats() const { return stats; }
+
+    // 打印函数
+    void printGrammar();
+    void printFirstSets();
+    void printFollowSets();
+    void printStates();
+    void printTable();
+};
+
+#endif
@@ -1,26 +1,119 @@
 #include "compiler.h"
+#include "compile_api.h"
+#include "server.h"
+#include "source_file.h"
+#include "direct_parser.h"
+#include <filesystem>
+
+// 命令行选项
+struct CliOptions {
+    string statsPath;   // 统计信息JSON输出路径，"-"表示标准输出
+    int threads;        // 构造分析表的线程数，0表示全部硬件线程
+    string grammarPath; // 文法文件，为空时使用内置文法
+    string cacheDir;    // 分析表缓存目录，为空（默认）时不缓存，避免在工作目录留下文件
+    bool optimize;      // 对中间代码做优化
+    bool run;           // 编译后执行
+    map<string, int64_t> runInput;  // 执行时的变量初值
+    int repeat;         // 执行次数
+    NativeTarget native;    // 本地代码后端
+    int batchRows;      // 列式批量执行的记录数，0表示不执行
+    string objectPath;  // 目标文件输出路径
+    string servePath;   // 编译服务的套接字路径，"-"表示使用标准输入输出
+    OutputFormat output;    // 编译过程的输出格式
+    bool directParse;   // 允许使用生成的直接编码分析器
+    string directPath;  // 生成直接编码分析器的输出路径
+    int benchParse;     // 分析器基准的重复次数，0表示不做
+    int benchLex;       // 词法分析基准的重复次数，0表示不做
+    int benchApi;       // 多线程库接口基准中每个线程的编译次数，0表示不做
+    string profileOut;  // 记录分析表访问次数的剖析文件
+    string profilePath; // 按此剖析文件重排分析表
+    bool unitChains;    // 跳过只传递语义值的单产生式归约
+    bool allocReport;   // 结束时打印各阶段的堆分配统计
+    string allocJson;   // 各阶段的堆分配统计以JSON写入此文件
+
+    CliOptions() : threads(0), optimize(false), run(false), repeat(1), native(NATIVE_NONE),
+        batchRows(0), output(OUTPUT_TEXT), directParse(true), benchParse(0), benchLex(0), benchApi(0),
+        unitChains(false), allocReport(false) {}
+};
+
+static CliOptions options;
+static ParseProfile profile;    // --profile-out 时各次编译累计的表访问次数
+
+// 按命令行选项配置分析器
+void configureParser(LR1Parser& parser) {
+    parser.setBuildThreads(options.threads);
+    parser.setGrammarFile(options.grammarPath);
+    parser.setCacheDir(options.cacheDir);
+    parser.setProfileFile(options.profilePath);
+    parser.setUnitElimination(options.unitChains);
+    // jsonl和binary输出给程序读取，构造分析表的进度改写到标准错误，不混入标准输出；
+    // none表示完全不输出，进度直接丢弃，文法错误仍写到标准错误
+    if (options.output == OUTPUT_JSONL || options.output == OUTPUT_BINARY) {
+        parser.setStreams(cerr.rdbuf(), cerr.rdbuf());
+    }
+    else if (options.output == OUTPUT_NONE) {
+        parser.setStreams(nullptr, cerr.rdbuf());
+    }
+}
+
+// 解析 "a=1,b=2" 形式的变量绑定
+bool parseBindings(const string& text, map<string, int64_t>& input) {
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        size_t eq = item.find('=');
+        if (eq == string::npos || eq == 0 || eq + 1 >= item.size()) {
+            cerr << "变量绑定格式错误：" << item << "（应为 名字=整数）" << endl;
+            return false;
+        }
+        char* end = nullptr;
+        long long v = strtoll(item.c_str() + eq + 1, &end, 10);
+        if (*end != '\0') {
+            cerr << "变量绑定格式错误：" << item << "（应为 名字=整数）" << endl;
+            return false;
+        }
+        input[item.substr(0, eq)] = v;
+    }
+    return true;
+}
+
+// 按命令行选项配置编译器
+void configureCompiler(Compiler& compiler) {
+    configureParser(compiler.getParser());
+    compiler.setOptimize(options.optimize);
+    compiler.setNativeTarget(options.native);
+    compiler.setBatch(options.batchRows, options.threads);
+    compiler.setLexThreads(options.threads);
+    compiler.setObjectOutput(options.objectPath);
+    compiler.setOutputFormat(options.output);
+    compiler.setDirectParse(options.directParse);
+    if (!options.profileOut.empty()) compiler.setProfile(&profile);
+    if (options.run) compiler.setRunInput(options.runInput, options.repeat);
+}
 
 void printMenu() {
-    cout << "\nXTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTT[" << endl;
-    cout << "U       IF-ELSE䷭ (LR1)               U" << endl;
-    cout << "dTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTg" << endl;
-    cout << "U  1. Դб                                 U" << endl;
-    cout << "U  2. ʾ                                       U" << endl;
-    cout << "U  3. ʾķʽ                                     U" << endl;
-    cout << "U  4. ʾFIRSTFOLLOW                              U" << endl;
-    cout << "U  5. ʾLR(1)                                    U" << endl;
-    cout << "U  0. ˳                                           U" << endl;
-    cout << "^TTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTa" << endl;
-    cout << "ѡ: ";
+    cout << "\n╔════════════════════════════════════════════════════════╗" << endl;
+    cout << "║       IF-ELSE条件语句翻译程序 (LR1方法)               ║" << endl;
+    cout << "╠════════════════════════════════════════════════════════╣" << endl;
+    cout << "║  1. 输入源程序进行编译                                 ║" << endl;
+    cout << "║  2. 运行示例程序                                       ║" << endl;
+    cout << "║  3. 显示文法产生式                                     ║" << endl;
+    cout << "║  4. 显示FIRST集和FOLLOW集                              ║" << endl;
+    cout << "║  5. 显示LR(1)分析表                                    ║" << endl;
+    cout << "║  0. 退出程序                                           ║" << endl;
+    cout << "╚════════════════════════════════════════════════════════╝" << endl;
+    cout << "请选择: ";
 }
 
 void inputAndCompile() {
     Compiler compiler;
+    configureCompiler(compiler);
     string source;
 
-    cout << "\nԴ (END):" << endl;
-    cout << "ʾ: if (a > b) { x = a } else { x = b }" << endl;
-    cout << "" << endl;
+    cout << "\n请输入源程序 (输入END结束):" << endl;
+    cout << "示例: if (a > b) { x = a } else { x = b }" << endl;
+    cout << "───────────────────────────────────────────" << endl;
     cout << ">>> ";
 
     string line;
@@ -29,12 +122,12 @@ void inputAndCompile() {
         if (line == "END" || line == "end") {
             break;
         }
-        source += line + " ";
+        source += line + "\n";
         cout << ">>> ";
     }
 
     if (source.empty()) {
-        cout << "Ϊգ" << endl;
+        cout << "输入为空！" << endl;
         return;
     }
 
@@ -43,14 +136,15 @@ void inputAndCompile() {
 
 void runExamples() {
     Compiler compiler;
+    configureCompiler(compiler);
     int choice;
 
-    cout << "\nѡʾ:" << endl;
+    cout << "\n选择示例程序:" << endl;
     cout << "  1. if (a > b) { x = a }" << endl;
     cout << "  2. if (a > b) { x = a } else { x = b }" << endl;
     cout << "  3. if (a + 1 > b * 2) { x = a + b }" << endl;
     cout << "  4. if (a >= b) { x = a; y = b } else { x = b; y = a }" << endl;
-    cout << "ѡ (1-4): ";
+    cout << "请选择 (1-4): ";
     cin >> choice;
     cin.ignore();
 
@@ -61,7 +155,7 @@ void runExamples() {
     case 3: source = "if (a + 1 > b * 2) { x = a + b }"; break;
     case 4: source = "if (a >= b) { x = a; y = b } else { x = b; y = a }"; break;
     default:
-        cout << "Чѡ" << endl;
+        cout << "无效选择！" << endl;
         return;
     }
 
@@ -70,74 +164,439 @@ void runExamples() {
 
 void showGrammar() {
     LR1Parser parser;
-    cout << "\nڳʼ..." << endl;
-    parser.init();
+    configureParser(parser);
+    cout << "\n正在初始化..." << endl;
+    if (!parser.init()) return;
     parser.printGrammar();
 }
 
 void showFirstFollow() {
     LR1Parser parser;
-    cout << "\nڼFIRSTFOLLOW..." << endl;
-    parser.init();
+    configureParser(parser);
+    cout << "\n正在计算FIRST集和FOLLOW集..." << endl;
+    if (!parser.init()) return;
     parser.printFirstSets();
     parser.printFollowSets();
 }
 
 void showLR1Table() {
     LR1Parser parser;
-    cout << "\nڹLR(1)..." << endl;
-    parser.init();
+    configureParser(parser);
+    cout << "\n正在构造LR(1)分析表..." << endl;
+    if (!parser.init()) return;
     parser.printTable();
 }
 
-int main(int argc, char* argv[]) {
-    // ģʽ
-    if (argc >= 2) {
-        string arg = argv[1];
+// 写出累计的剖析数据
+bool saveProfile(const LR1Parser& parser, const CliOptions& opt) {
+    if (opt.profileOut.empty()) return true;
+    string error;
+    if (!profile.save(parser, opt.profileOut, error)) {
+        cerr << error << endl;
+        return false;
+    }
+    cout << "剖析数据已写入 " << opt.profileOut << "（" << profile.total() << " 次表访问）" << endl;
+    return true;
+}
+
+// 用库接口在1、2、4……个线程中同时编译source，各线程使用自己的会话、共享一份分析表，
+// 核对每次的结果与单线程一致，报告吞吐量
+bool benchmarkLibrary(string_view source, const CliOptions& opt) {
+    CompileLibrary library;
+    configureParser(library.getParser());
+    string error;
+    if (!library.init(error)) {
+        cerr << error << endl;
+        return false;
+    }
+
+    CompileOptions options;
+    options.optimize = opt.optimize;
+    options.directParse = opt.directParse;
+    CompileResult expected = library.compile(source, options);
+
+    int maxThreads = opt.threads > 0 ? opt.threads : max((int)thread::hardware_concurrency(), 1);
+    vector<int> counts;
+    for (int t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+    counts.push_back(maxThreads);
+
+    auto sameResult = [&](const CompileResult& r) {
+        if (r.success != expected.success || r.code.size() != expected.code.size() ||
+            r.diagnostics.size() != expected.diagnostics.size()) return false;
+        for (size_t i = 0; i < r.code.size(); i++) {
+            const Quadruple& x = r.code[i];
+            const Quadruple& y = expected.code[i];
+            if (x.op != y.op || x.arg1 != y.arg1 || x.arg2 != y.arg2 || x.result != y.result) return false;
+        }
+        for (size_t i = 0; i < r.diagnostics.size(); i++) {
+            if (r.diagnostics[i].line != expected.diagnostics[i].line ||
+                r.diagnostics[i].message != expected.diagnostics[i].message) return false;
+        }
+        return true;
+    };
+
+    ostringstream report;
+    report << fixed << setprecision(1);
+    report << "\n库接口基准：每个线程编译 " << opt.benchApi << " 次\n";
+    double base = 0;
+    for (int t : counts) {
+        atomic<int> mismatches(0);
+        vector<thread> workers;
+        Stopwatch timer;
+        for (int k = 0; k < t; k++) {
+            workers.push_back(thread([&] {
+                CompileSession session(library);
+                for (int i = 0; i < opt.benchApi; i++) {
+                    if (!sameResult(session.compile(source, options))) mismatches++;
+                }
+            }));
+        }
+        for (thread& w : workers) w.join();
+        double ms = timer.elapsedMs();
+        if (mismatches > 0) {
+            cerr << t << " 个线程同时编译时有 " << mismatches << " 次结果与单线程不一致" << endl;
+            return false;
+        }
+        double rate = ms > 0 ? (double)t * opt.benchApi / (ms / 1000.0) : 0;
+        if (t == 1) base = rate;
+        report << setw(3) << t << " 线程：" << rate << " 次/秒，加速比 " << setprecision(2)
+            << (base > 0 ? rate / base : 0) << setprecision(1) << "\n";
+    }
+    report << "各线程的四元式和诊断与单线程编译一致\n";
+    cout << report.str() << endl;
+    return true;
+}
+
+// 编译并按选项输出统计信息
+int runCompile(string_view source, const CliOptions& opt) {
+    Compiler compiler;
+    configureCompiler(compiler);
+    bool ok = compiler.compile(source);
+    if (ok && opt.benchParse > 0) ok = compiler.benchmarkParse(opt.benchParse);
+    // 词法分析基准不依赖编译成功，有词法错误的源码正好用来核对错误的行号
+    if (opt.benchLex > 0 && !compiler.benchmarkLex(source, opt.benchLex, opt.threads)) ok = false;
+    if (opt.benchApi > 0 && !benchmarkLibrary(source, opt)) ok = false;
+    if (!saveProfile(compiler.getParser(), opt)) return 1;
+
+    if (!opt.statsPath.empty()) {
+        if (opt.statsPath == "-") {
+            compiler.printStatsJson(cout);
+        }
+        else {
+            ofstream out(opt.statsPath);
+            if (!out.is_open()) {
+                cerr << "无法写入统计文件：" << opt.statsPath << endl;
+                return 1;
+            }
+            compiler.printStatsJson(out);
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+// 由分析表生成直接编码的分析器源码
+int generateDirectParser(const CliOptions& opt) {
+    LR1Parser parser;
+    configureParser(parser);
+    if (!parser.init()) return 1;
+    string error;
+    if (!DirectParserGenerator::write(parser, opt.directPath, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+    cout << "已生成 " << opt.directPath << "（" << parser.getStateCount() << " 个状态）" << endl;
+    return 0;
+}
+
+// 批量编译目录下的全部文件（按文件名排序）：读取线程预读后面的文件，与编译重叠
+int runDirectory(const string& dir, const CliOptions& opt) {
+    vector<string> paths;
+    error_code ec;
+    for (const auto& entry : filesystem::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file()) paths.push_back(entry.path().string());
+    }
+    if (ec) {
+        cerr << "无法读取目录：" << dir << endl;
+        return 1;
+    }
+    sort(paths.begin(), paths.end());
+
+    // 分析表只构造一次，各文件的编译只输出结果
+    LR1Parser parser;
+    configureParser(parser);
+    if (!parser.init()) return 1;
+    Compiler compiler(&parser);
+    configureCompiler(compiler);
+    compiler.setQuiet(true);
+
+    Stopwatch total;
+    double waitMs = 0, compileMs = 0;
+    size_t bytes = 0;
+    int failed = 0;
+    FilePrefetcher prefetcher(paths);
+    FilePrefetcher::Item item;
+    while (true) {
+        Stopwatch wait;
+        bool more = prefetcher.next(item);
+        waitMs += wait.elapsedMs();
+        if (!more) break;
+
+        if (!item.ok) {
+            cerr << item.error << endl;
+            failed++;
+            continue;
+        }
+        bytes += item.file.text().size();
+
+        Stopwatch timer;
+        bool ok = compiler.compile(item.file.text());
+        compileMs += timer.elapsedMs();
+        if (ok) {
+            cout << item.path << "：成功，" << compiler.getCode().size() << " 条四元式" << endl;
+            continue;
+        }
+        failed++;
+        cout << item.path << "：失败" << endl;
+        for (const Diagnostic& d : compiler.getDiagnostics()) {
+            cout << "  第 " << d.line << " 行：" << d.message << endl;
+        }
+    }
+
+    cout << "\n共 " << paths.size() << " 个文件（" << bytes << " 字节），成功 " << paths.size() - failed
+        << " 个，失败 " << failed << " 个" << endl;
+    cout << "编译 " << compileMs << " ms，等待读取 " << waitMs << " ms，总计 " << total.elapsedMs() << " ms" << endl;
+    if (!saveProfile(parser, opt)) return 1;
+    return failed == 0 ? 0 : 1;
+}
+
+// 常驻编译服务：分析表只构造一次
+int runServer(const CliOptions& opt) {
+    CompileServer server(opt.threads, opt.optimize);
+    configureParser(server.getParser());
+    // 标准输出用于传输响应，构造分析表时的提示改写到标准错误
+    if (opt.servePath == "-") server.getParser().setStreams(cerr.rdbuf(), cerr.rdbuf());
+    if (!server.init()) {
+        cerr << "分析表构造失败！" << endl;
+        return 1;
+    }
+
+    if (opt.servePath == "-") return server.serveStdio();
+#ifndef _WIN32
+    return server.serveSocket(opt.servePath);
+#else
+    cerr << "当前平台不支持Unix域套接字，请使用 --serve -" << endl;
+    return 1;
+#endif
+}
+
+// 加载目标文件并用虚拟机执行，不经过编译
+int runImages(const vector<string>& paths, const CliOptions& opt) {
+    vector<unique_ptr<ProgramImage>> images;
+    Stopwatch timer;
+    for (const string& path : paths) {
+        images.push_back(unique_ptr<ProgramImage>(new ProgramImage()));
+        string error;
+        if (!images.back()->load(path, error)) {
+            cerr << path << "：" << error << endl;
+            return 1;
+        }
+    }
+    double loadMs = timer.elapsedMs();
+    cout << "加载并校验 " << images.size() << " 个目标文件，耗时 " << loadMs << " ms" << endl;
+
+    int failed = 0;
+    for (size_t i = 0; i < images.size(); i++) {
+        ProgramView view = images[i]->view();
+        map<string, int64_t> output;
+        VMStatus status = VM::run(view, images[i]->names(), opt.runInput, output);
+
+        cout << "\n" << paths[i] << "（" << view.count << " 条指令）：" << endl;
+        if (status != VM_OK) {
+            cerr << "执行出错：" << VM::statusText(status) << endl;
+            failed++;
+            continue;
+        }
+        for (const auto& kv : output) {
+            cout << "  " << kv.first << " = " << kv.second << endl;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+int runMain(int argc, char* argv[]) {
+    // 解析选项，其余参数按原方式处理
+    CliOptions& opt = options;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if ((a == "-j" || a == "--stats-json") && i + 1 < argc) {
+            opt.statsPath = argv[++i];
+        }
+        else if (a == "--threads" && i + 1 < argc) {
+            opt.threads = atoi(argv[++i]);
+        }
+        else if (a == "-g" && i + 1 < argc) {
+            opt.grammarPath = argv[++i];
+        }
+        else if (a == "--cache-dir" && i + 1 < argc) {
+            opt.cacheDir = argv[++i];
+        }
+        else if (a == "--no-cache") {
+            opt.cacheDir = "";
+        }
+        else if (a == "-O" || a == "--optimize") {
+            opt.optimize = true;
+        }
+        else if (a == "--run" && i + 1 < argc) {
+            opt.run = true;
+            if (!parseBindings(argv[++i], opt.runInput)) return 1;
+        }
+        else if (a == "--repeat" && i + 1 < argc) {
+            opt.repeat = atoi(argv[++i]);
+        }
+        else if (a == "--serve" && i + 1 < argc) {
+            opt.servePath = argv[++i];
+        }
+        else if (a == "-o" && i + 1 < argc) {
+            opt.objectPath = argv[++i];
+        }
+        else if (a == "--batch" && i + 1 < argc) {
+            opt.batchRows = atoi(argv[++i]);
+        }
+        else if (a == "--output" && i + 1 < argc) {
+            string format = argv[++i];
+            if (format == "text") opt.output = OUTPUT_TEXT;
+            else if (format == "jsonl") opt.output = OUTPUT_JSONL;
+            else if (format == "binary") opt.output = OUTPUT_BINARY;
+            else if (format == "none") opt.output = OUTPUT_NONE;
+            else {
+                cerr << "未知的输出格式：" << format << "（应为 text、jsonl、binary 或 none）" << endl;
+                return 1;
+            }
+        }
+        else if (a == "--gen-direct" && i + 1 < argc) {
+            opt.directPath = argv[++i];
+        }
+        else if (a == "--table-parse") {
+            opt.directParse = false;
+        }
+        else if (a == "--bench-parse" && i + 1 < argc) {
+            opt.benchParse = atoi(argv[++i]);
+        }
+        else if (a == "--profile-out" && i + 1 < argc) {
+            opt.profileOut = argv[++i];
+        }
+        else if (a == "--profile" && i + 1 < argc) {
+            opt.profilePath = argv[++i];
+        }
+        else if (a == "--bench-lex" && i + 1 < argc) {
+            opt.benchLex = atoi(argv[++i]);
+        }
+        else if (a == "--bench-api" && i + 1 < argc) {
+            opt.benchApi = atoi(argv[++i]);
+        }
+        else if (a == "--alloc-report") {
+            opt.allocReport = true;
+        }
+        else if (a == "--alloc-json" && i + 1 < argc) {
+            opt.allocJson = argv[++i];
+        }
+        else if (a == "--skip-unit") {
+            opt.unitChains = true;
+        }
+        else if (a == "--native" && i + 1 < argc) {
+            string target = argv[++i];
+            if (target == "c") opt.native = NATIVE_C;
+            else if (target == "asm") opt.native = NATIVE_ASM;
+            else {
+                cerr << "未知的本地代码目标：" << target << "（应为 c 或 asm）" << endl;
+                return 1;
+            }
+        }
+        else {
+            args.push_back(a);
+        }
+    }
+
+    if (!opt.servePath.empty()) {
+        return runServer(opt);
+    }
+    if (!opt.directPath.empty()) {
+        return generateDirectParser(opt);
+    }
+
+    // 命令行模式
+    if (!args.empty()) {
+        string arg = args[0];
 
         if (arg == "-h" || arg == "--help") {
-            cout << "÷" << endl;
-            cout << "  ./compiler              ģʽ" << endl;
-            cout << "  ./compiler -e \"code\"    ֱӱ" << endl;
-            cout << "  ./compiler <file>       ļ" << endl;
-            cout << "  ./compiler -t           ʾ" << endl;
+            cout << "用法：" << endl;
+            cout << "  ./compiler              交互模式" << endl;
+            cout << "  ./compiler -e \"code\"    直接编译代码" << endl;
+            cout << "  ./compiler <file>       编译文件" << endl;
+            cout << "  ./compiler <dir>        批量编译目录下的全部文件（预读下一个文件）" << endl;
+            cout << "  ./compiler -t           显示分析表" << endl;
+            cout << "  ./compiler -x <obj>...  加载目标文件并执行（变量初值由--run给出）" << endl;
+            cout << "选项：" << endl;
+            cout << "  -j, --stats-json <file> 将编译统计以JSON格式写入文件（- 表示标准输出）" << endl;
+            cout << "  --threads <n>           构造分析表、分块词法分析及批量执行的线程数（默认使用全部核心）" << endl;
+            cout << "  -g <grammar>            从文件读取文法（默认使用内置文法，见 ifelse.grammar）" << endl;
+            cout << "  --cache-dir <dir>       把分析表缓存在该目录，之后启动直接加载（默认不缓存）" << endl;
+            cout << "  --no-cache              不读写分析表缓存（取消之前的 --cache-dir）" << endl;
+            cout << "  -O, --optimize          优化生成的四元式（窥孔优化、死代码删除）" << endl;
+            cout << "  --run <a=1,b=2>         编译后用字节码虚拟机执行，参数为变量初值（可为空串）" << endl;
+            cout << "  --repeat <n>            执行n次并报告平均耗时" << endl;
+            cout << "  --batch <n>             对n条随机记录做列式批量执行，报告吞吐量" << endl;
+            cout << "  --native <c|asm>        生成C或x86-64汇编，用系统编译器编译并加载，与虚拟机比对后执行" << endl;
+            cout << "  -o <file>               把字节码写入二进制目标文件（可用mmap加载直接执行）" << endl;
+            cout << "  --serve <socket|->      常驻编译服务，在Unix域套接字（- 为标准输入输出）上接收请求帧" << endl;
+            cout << "  --output <format>       编译过程的输出格式：text（默认）、jsonl、binary 或 none" << endl;
+            cout << "  --gen-direct <file>     由分析表生成直接编码的分析器（C++，见 direct_parser.inc）" << endl;
+            cout << "  --table-parse           不使用直接编码的分析器，始终按分析表分析" << endl;
+            cout << "  --bench-parse <n>       编译后用两种分析器各重复分析n次，比较耗时" << endl;
+            cout << "  --profile-out <file>    记录分析表各表项的访问次数（可对目录批量编译以覆盖整个语料）" << endl;
+            cout << "  --profile <file>        按剖析文件重排分析表的状态和列，使常用表项集中" << endl;
+            cout << "  --bench-lex <n>         编译后用1、2、4……个线程分块做词法分析各n次，报告吞吐量" << endl;
+            cout << "  --bench-api <n>         用库接口在1、2、4……个线程中同时编译，每个线程n次，核对结果并报告吞吐量" << endl;
+            cout << "  --alloc-report          结束时打印各阶段的堆分配次数、字节数和峰值（须以 LR1_ALLOC_STATS 编译）" << endl;
+            cout << "  --alloc-json <file>     各阶段的堆分配统计以JSON写入文件（- 表示标准输出）" << endl;
+            cout << "  --skip-unit             用链式GOTO表跳过无语义动作的单产生式归约（如 E -> T）" << endl;
             return 0;
         }
         else if (arg == "-t") {
             showLR1Table();
             return 0;
         }
-        else if (arg == "-e" && argc >= 3) {
-            Compiler compiler;
-            compiler.compile(argv[2]);
-            return 0;
+        else if (arg == "-x" && args.size() >= 2) {
+            return runImages(vector<string>(args.begin() + 1, args.end()), opt);
+        }
+        else if (arg == "-e" && args.size() >= 2) {
+            return runCompile(args[1], opt);
         }
         else {
-            // ļȡ
-            ifstream file(arg);
-            if (!file.is_open()) {
-                cerr << "޷ļ" << arg << endl;
-                return 1;
-            }
-            string source, line;
-            while (getline(file, line)) {
-                source += line + " ";
+            error_code ec;
+            if (filesystem::is_directory(arg, ec)) {
+                return runDirectory(arg, opt);
             }
-            file.close();
 
-            Compiler compiler;
-            compiler.compile(source);
-            return 0;
+            // 从文件读取：整个文件一次映射，保留换行以便报告行号
+            SourceFile file;
+            string error;
+            if (!file.map(arg, error)) {
+                cerr << error << endl;
+                return 1;
+            }
+            return runCompile(file.text(), opt);
         }
     }
 
-    // ģʽ
+    // 交互模式
     int choice;
 
     while (true) {
         printMenu();
         cin >> choice;
-        cin.ignore();  // з
+        cin.ignore();  // 清除换行符
 
         switch (choice) {
         case 1:
@@ -156,15 +615,43 @@ int main(int argc, char* argv[]) {
             showLR1Table();
             break;
         case 0:
-            cout << "\nлʹãټ" << endl;
+            cout << "\n感谢使用，再见！" << endl;
             return 0;
         default:
-            cout << "Чѡԣ" << endl;
+            cout << "无效选择，请重试！" << endl;
         }
 
-        cout << "\nس...";
+        cout << "\n按回车键继续...";
         cin.get();
     }
 
     return 0;
 }
+
+// 运行结束时输出堆分配统计（须以 LR1_ALLOC_STATS 编译）
+bool writeAllocStats(const CliOptions& opt) {
+    if (!opt.allocReport && opt.allocJson.empty()) return true;
+    if (!AllocStats::enabled()) {
+        cerr << "本程序未以 LR1_ALLOC_STATS 编译，没有堆分配统计" << endl;
+        return false;
+    }
+    if (opt.allocReport) AllocStats::report(cout);
+    if (opt.allocJson.empty()) return true;
+    if (opt.allocJson == "-") {
+        AllocStats::writeJson(cout);
+        return true;
+    }
+    ofstream out(opt.allocJson);
+    if (!out.is_open()) {
+        cerr << "无法写入分配统计文件：" << opt.allocJson << endl;
+        return false;
+    }
+    AllocStats::writeJson(out);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int rc = runMain(argc, argv);
+    if (!writeAllocStats(options)) rc = 1;
+    return rc;
+}
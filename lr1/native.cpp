@@ -0,0 +1,329 @@
+#include "native.h"
+#include <random>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
+
+NativeProgram::NativeProgram() : handle(nullptr), fn(nullptr) {}
+
+NativeProgram::~NativeProgram() {
+    unload();
+}
+
+void NativeProgram::unload() {
+#ifndef _WIN32
+    if (handle != nullptr) dlclose(handle);
+    if (!workDir.empty()) {
+        static const char* const FILES[] = { "/program.c", "/program.s", "/program.so", "/build.log" };
+        for (const char* f : FILES) remove((workDir + f).c_str());
+        rmdir(workDir.c_str());
+    }
+#endif
+    handle = nullptr;
+    fn = nullptr;
+    workDir = "";
+}
+
+// 指令下标是否为某条跳转的目标（只给这些指令生成标号）
+static vector<bool> branchTargets(const Bytecode& bc) {
+    vector<bool> targets(bc.ops.size(), false);
+    for (size_t i = 0; i < bc.ops.size(); i++) {
+        uint8_t op = bc.ops[i];
+        if (op == OP_JMP || (op >= OP_JLT && op <= OP_BNE)) targets[bc.c[i]] = true;
+        if (op >= OP_BLT && op <= OP_BNE) targets[bc.d[i]] = true;
+    }
+    return targets;
+}
+
+// C中INT64_MIN不能直接写成字面量
+static string cConstant(int64_t v) {
+    if (v == INT64_MIN) return "INT64_MIN";
+    return "INT64_C(" + to_string(v) + ")";
+}
+
+string NativeProgram::emitC(const Bytecode& bc) {
+    static const char* const CMP[] = { "<", "<=", ">", ">=", "==", "!=" };
+    int named = bc.names.size();
+
+    auto operand = [&](int32_t s) {
+        if (s < named) return "v" + to_string(s);
+        return cConstant(bc.constants[s - named]);
+    };
+
+    ostringstream out;
+    out << "/* 由LR(1)编译器生成，请勿修改 */\n";
+    out << "#include <stdint.h>\n\n";
+    out << "int lr1_program(int64_t* r) {\n";
+
+    // 变量和临时变量作为局部变量，便于C编译器分配寄存器
+    for (int s = 0; s < named; s++) {
+        out << "    int64_t v" << s << " = " << (s < bc.varSlots ? "r[" + to_string(s) + "]" : "0")
+            << ";  /* " << bc.names[s] << " */\n";
+    }
+    out << "\n";
+
+    // 正常结束和除零出错时都把变量写回r：出错时的状态与虚拟机、汇编后端一样停在出错的指令
+    string writeBack;
+    for (int s = 0; s < bc.varSlots; s++) {
+        writeBack += "r[" + to_string(s) + "] = v" + to_string(s) + "; ";
+    }
+
+    vector<bool> targets = branchTargets(bc);
+    for (size_t i = 0; i < bc.ops.size(); i++) {
+        uint8_t op = bc.ops[i];
+        if (targets[i]) out << "L" << i << ":\n";
+
+        // 跳转指令的c、d是指令下标，不是槽位
+        bool hasDest = op >= OP_MOV && op <= OP_DIV;
+        bool hasArgs = op != OP_HALT && op != OP_JMP;
+        string a = hasArgs ? operand(bc.a[i]) : "";
+        string b = hasArgs && op != OP_MOV ? operand(bc.b[i]) : "";
+        string c = hasDest ? operand(bc.c[i]) : "";
+
+        if (op == OP_MOV) {
+            out << "    " << c << " = " << a << ";\n";
+        }
+        else if (op == OP_ADD || op == OP_SUB || op == OP_MUL) {
+            // 按无符号运算，溢出时回绕（与虚拟机一致）
+            const char* sym = op == OP_ADD ? "+" : op == OP_SUB ? "-" : "*";
+            out << "    " << c << " = (int64_t)((uint64_t)" << a << " " << sym << " (uint64_t)" << b << ");\n";
+        }
+        else if (op == OP_DIV) {
+            out << "    if (" << b << " == 0 || (" << b << " == -1 && " << a << " == INT64_MIN)) { "
+                << writeBack << "return " << VM_DIV_ZERO << "; }\n";
+            out << "    " << c << " = " << a << " / " << b << ";\n";
+        }
+        else if (op == OP_JMP) {
+            out << "    goto L" << bc.c[i] << ";\n";
+        }
+        else if (op >= OP_JLT && op <= OP_JNE) {
+            out << "    if (" << a << " " << CMP[op - OP_JLT] << " " << b << ") goto L" << bc.c[i] << ";\n";
+        }
+        else if (op >= OP_BLT && op <= OP_BNE) {
+            out << "    if (" << a << " " << CMP[op - OP_BLT] << " " << b << ") goto L" << bc.c[i]
+                << "; else goto L" << bc.d[i] << ";\n";
+        }
+        else if (op == OP_HALT) {
+            out << "    " << writeBack << "return 0;\n";
+        }
+    }
+    out << "}\n";
+    return out.str();
+}
+
+string NativeProgram::emitAsm(const Bytecode& bc) {
+    static const char* const JCC[] = { "jl", "jle", "jg", "jge", "je", "jne" };
+    int named = bc.names.size();
+
+    ostringstream out;
+
+    // 把槽位s装入寄存器reg：常量用立即数，其余从r（%rdi）读取
+    auto load = [&](int32_t s, const char* reg) {
+        if (s < named) out << "    movq " << s * 8 << "(%rdi), " << reg << "\n";
+        else out << "    movabsq $" << bc.constants[s - named] << ", " << reg << "\n";
+    };
+    auto store = [&](int32_t s, const char* reg) {
+        out << "    movq " << reg << ", " << s * 8 << "(%rdi)\n";
+    };
+
+    out << "# 由LR(1)编译器生成，请勿修改\n";
+    out << "    .text\n";
+    out << "    .globl lr1_program\n";
+    out << "    .type lr1_program, @function\n";
+    out << "lr1_program:\n";
+
+    vector<bool> targets = branchTargets(bc);
+    for (size_t i = 0; i < bc.ops.size(); i++) {
+        uint8_t op = bc.ops[i];
+        if (targets[i]) out << ".Lq" << i << ":\n";
+
+        if (op == OP_MOV) {
+            load(bc.a[i], "%rax");
+            store(bc.c[i], "%rax");
+        }
+        else if (op == OP_ADD || op == OP_SUB || op == OP_MUL) {
+            load(bc.a[i], "%rax");
+            load(bc.b[i], "%rcx");
+            out << "    " << (op == OP_ADD ? "addq" : op == OP_SUB ? "subq" : "imulq") << " %rcx, %rax\n";
+            store(bc.c[i], "%rax");
+        }
+        else if (op == OP_DIV) {
+            load(bc.a[i], "%rax");
+            load(bc.b[i], "%rcx");
+            out << "    testq %rcx, %rcx\n";
+            out << "    jz .Ldivzero\n";
+            out << "    cmpq $-1, %rcx\n";
+            out << "    jne .Ldiv" << i << "\n";
+            out << "    movabsq $-9223372036854775808, %rdx\n";
+            out << "    cmpq %rdx, %rax\n";
+            out << "    je .Ldivzero\n";
+            out << ".Ldiv" << i << ":\n";
+            out << "    cqto\n";
+            out << "    idivq %rcx\n";
+            store(bc.c[i], "%rax");
+        }
+        else if (op == OP_JMP) {
+            out << "    jmp .Lq" << bc.c[i] << "\n";
+        }
+        else if (op >= OP_JLT && op <= OP_BNE) {
+            bool fused = op >= OP_BLT;
+            load(bc.a[i], "%rax");
+            load(bc.b[i], "%rcx");
+            out << "    cmpq %rcx, %rax\n";
+            out << "    " << JCC[op - (fused ? OP_BLT : OP_JLT)] << " .Lq" << bc.c[i] << "\n";
+            if (fused) out << "    jmp .Lq" << bc.d[i] << "\n";
+        }
+        else if (op == OP_HALT) {
+            out << "    xorl %eax, %eax\n";
+            out << "    ret\n";
+        }
+    }
+
+    out << ".Ldivzero:\n";
+    out << "    movl $" << VM_DIV_ZERO << ", %eax\n";
+    out << "    ret\n";
+    out << "    .size lr1_program, .-lr1_program\n";
+    out << "    .section .note.GNU-stack,\"\",@progbits\n";
+    return out.str();
+}
+
+#ifndef _WIN32
+// 不经过shell直接执行编译器，标准输出和标准错误写入logPath；路径中的引号等字符不会被解释。
+// 成功启动并返回0时为true
+static bool runCommand(const vector<string>& args, const string& logPath) {
+    vector<char*> argv;
+    for (const string& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int fd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execvp(argv[0], argv.data());
+        fprintf(stderr, "无法执行 %s\n", argv[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
+bool NativeProgram::build(const Bytecode& bc, NativeTarget target, string& error) {
+    unload();
+
+#ifdef _WIN32
+    error = "当前平台不支持加载本地代码";
+    return false;
+#else
+#if !defined(__x86_64__)
+    if (target == NATIVE_ASM) {
+        error = "汇编后端只支持x86-64";
+        return false;
+    }
+#endif
+
+    const char* tmp = getenv("TMPDIR");
+    string pattern = string(tmp != nullptr && *tmp ? tmp : "/tmp") + "/lr1_native_XXXXXX";
+    vector<char> dirBuf(pattern.begin(), pattern.end());
+    dirBuf.push_back('\0');
+    if (mkdtemp(dirBuf.data()) == nullptr) {
+        error = "无法创建临时目录：" + pattern;
+        return false;
+    }
+    workDir = dirBuf.data();
+
+    string source = workDir + (target == NATIVE_C ? "/program.c" : "/program.s");
+    string library = workDir + "/program.so";
+    string log = workDir + "/build.log";
+
+    ofstream src(source);
+    src << (target == NATIVE_C ? emitC(bc) : emitAsm(bc));
+    src.close();
+    if (!src) {
+        error = "无法写入源文件：" + source;
+        return false;
+    }
+
+    // CC可以带参数（如 "ccache gcc"），按空白切分
+    const char* cc = getenv("CC");
+    vector<string> args;
+    istringstream ccWords(cc != nullptr && *cc ? cc : "cc");
+    for (string w; ccWords >> w; ) args.push_back(w);
+    if (args.empty()) args.push_back("cc");
+    for (const char* a : { "-O2", "-shared", "-fPIC", "-o" }) args.push_back(a);
+    args.push_back(library);
+    args.push_back(source);
+
+    if (!runCommand(args, log)) {
+        string cmd;
+        for (const string& a : args) cmd += (cmd.empty() ? "" : " ") + a;
+        ifstream in(log);
+        stringstream ss;
+        ss << in.rdbuf();
+        error = "编译本地代码失败：" + cmd + "\n" + ss.str();
+        return false;
+    }
+
+    handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        error = string("dlopen失败：") + dlerror();
+        return false;
+    }
+    fn = (NativeFn)dlsym(handle, "lr1_program");
+    if (fn == nullptr) {
+        error = "共享库中找不到lr1_program";
+        return false;
+    }
+    return true;
+#endif
+}
+
+int NativeProgram::validate(const Bytecode& bc, int samples, ostream& log) const {
+    ProgramView view = bc.view();
+    int slots = view.slotCount();
+
+    // 固定种子，结果可复现；取值偏小以便覆盖比较的两个分支，同时夹杂边界值
+    mt19937_64 rng(20240601);
+    uniform_int_distribution<int64_t> small(-8, 8);
+    const int64_t EDGES[] = { 0, 1, -1, INT64_MAX, INT64_MIN };
+
+    int mismatches = 0;
+    for (int n = 0; n < samples; n++) {
+        vector<int64_t> expect(slots, 0), actual;
+        for (int s = 0; s < view.varSlots; s++) {
+            expect[s] = (rng() % 16 == 0) ? EDGES[rng() % 5] : small(rng);
+        }
+        actual = expect;
+        vector<int64_t> input(expect.begin(), expect.begin() + view.varSlots);
+
+        VMStatus vs = VM::execute(view, expect.data());
+        VMStatus ns = call(actual.data());
+
+        // 出错时变量停在出错的指令处，同样要一致
+        bool same = vs == ns && equal(expect.begin(), expect.begin() + view.varSlots, actual.begin());
+        if (same) continue;
+
+        if (mismatches++ < 5) {
+            log << "  不一致：输入";
+            for (int s = 0; s < view.varSlots; s++) log << " " << bc.names[s] << "=" << input[s];
+            log << "；虚拟机 " << VM::statusText(vs) << "，本地代码 " << VM::statusText(ns) << endl;
+        }
+    }
+    return mismatches;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "common.h"
+#include "vm.h"
+
+// 本地代码的目标形式
+enum NativeTarget {
+    NATIVE_NONE,
+    NATIVE_C,       // 生成C函数，由系统C编译器编译
+    NATIVE_ASM      // 生成x86-64汇编（System V调用约定，AT&T语法）
+};
+
+// 生成的函数：int lr1_program(int64_t* r)
+// r的布局与虚拟机寄存器组相同，返回值同VMStatus；结束时程序变量写回r
+typedef int (*NativeFn)(int64_t* r);
+
+// ==================== 本地代码后端 ====================
+// 把字节码翻译为C或汇编源码，用系统工具链编译为共享库并用dlopen加载
+class NativeProgram {
+private:
+    void* handle;
+    NativeFn fn;
+    string workDir;     // 存放源码和共享库的临时目录
+
+    void unload();
+
+public:
+    NativeProgram();
+    ~NativeProgram();
+
+    static string emitC(const Bytecode& bc);
+    static string emitAsm(const Bytecode& bc);
+
+    // 生成、编译并加载；编译器取环境变量CC，默认为cc
+    bool build(const Bytecode& bc, NativeTarget target, string& error);
+
+    bool loaded() const { return fn != nullptr; }
+    VMStatus call(int64_t* r) const { return (VMStatus)fn(r); }
+
+    // 翻译确认：用随机输入分别运行虚拟机和本地代码，比较状态和程序变量的结果，返回不一致的次数
+    int validate(const Bytecode& bc, int samples, ostream& log) const;
+};
+
+#endif
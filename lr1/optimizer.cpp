@@ -0,0 +1,423 @@
+#include "optimizer.h"
+#include "semantic.h"
+#include "vm.h"
+#include <cerrno>
+
+Optimizer::Optimizer(QuadList& c, int baseAddr) : code(c), base(baseAddr) {}
+
+// 能用int64表示的整数常量；超出范围的字面量不折叠，留给运行时按原样处理
+bool Optimizer::toInt64(const string& s, long long& value) {
+    if (!isNumber(s)) return false;
+    errno = 0;
+    value = strtoll(s.c_str(), nullptr, 10);
+    return errno != ERANGE;
+}
+
+bool Optimizer::isNumber(const string& s) {
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+    if (i >= s.size()) return false;
+    for (; i < s.size(); i++) {
+        if (!isdigit((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+int Optimizer::targetIndex(const Quadruple& q) const {
+    if (!isJump(q.op) || !isNumber(q.result)) return -1;
+    int idx = atoi(q.result.c_str()) - base;
+    // 允许跳到末尾（程序结束）
+    if (idx < 0 || idx > (int)code.size()) return -1;
+    return idx;
+}
+
+vector<bool> Optimizer::jumpTargets() const {
+    vector<bool> targets(code.size() + 1, false);
+    for (const Quadruple& q : code) {
+        int t = targetIndex(q);
+        if (t >= 0) targets[t] = true;
+    }
+    return targets;
+}
+
+// 删除dead指令，跳向被删指令的跳转改为跳向其后第一条保留的指令
+void Optimizer::compact() {
+    int n = code.size();
+    vector<int> newIndex(n + 1);
+    int live = 0;
+    for (int i = 0; i < n; i++) {
+        newIndex[i] = live;
+        if (!dead[i]) live++;
+    }
+    newIndex[n] = live;
+
+    QuadList kept(code.get_allocator());
+    kept.reserve(live);
+    for (int i = 0; i < n; i++) {
+        if (dead[i]) continue;
+        Quadruple q = code[i];
+        int t = targetIndex(q);
+        if (t >= 0) q.result = to_string(base + newIndex[t]);
+        kept.push_back(q);
+    }
+    code.swap(kept);
+    dead.assign(code.size(), false);
+}
+
+// t = 1 + 2  =>  t = 3；if 1 < 2 goto L  =>  goto L
+bool Optimizer::foldConstants(OptimizeStats& st) {
+    bool changed = false;
+    for (size_t i = 0; i < code.size(); i++) {
+        Quadruple& q = code[i];
+        long long a, b;
+        if (!toInt64(q.arg1, a) || !toInt64(q.arg2, b)) continue;
+
+        if (q.op == "+" || q.op == "-" || q.op == "*" || q.op == "/") {
+            // 与虚拟机相同：加减乘按补码回绕
+            long long v;
+            if (q.op == "+") v = wrapAdd(a, b);
+            else if (q.op == "-") v = wrapSub(a, b);
+            else if (q.op == "*") v = wrapMul(a, b);
+            else {
+                // 除零和INT64_MIN / -1在运行时出错，留到运行时
+                if (b == 0 || (b == -1 && a == INT64_MIN)) continue;
+                v = a / b;
+            }
+            q = Quadruple("=", to_string(v), "_", q.result);
+        }
+        else if (isJump(q.op) && q.op != "j") {
+            string rop = q.op.substr(1);
+            bool taken;
+            if (rop == ">") taken = a > b;
+            else if (rop == "<") taken = a < b;
+            else if (rop == ">=") taken = a >= b;
+            else if (rop == "<=") taken = a <= b;
+            else if (rop == "==") taken = a == b;
+            else if (rop == "!=") taken = a != b;
+            else continue;
+
+            if (taken) {
+                q = Quadruple("j", "_", "_", q.result);
+            }
+            else {
+                dead[i] = true;     // 条件恒假，顺序执行
+            }
+        }
+        else {
+            continue;
+        }
+        st.folded++;
+        changed = true;
+    }
+    if (changed) compact();
+    return changed;
+}
+
+// t = 3 ... x = t + y  =>  x = 3 + y（同一基本块内，且t在这次使用后不再活跃）
+bool Optimizer::propagateConstants(OptimizeStats& st) {
+    vector<set<string>> liveAfter = liveness();
+    vector<bool> targets = jumpTargets();
+
+    bool changed = false;
+    for (size_t i = 0; i < code.size(); i++) {
+        const Quadruple& def = code[i];
+        if (dead[i] || def.op != "=" || !isNumber(def.arg1) || !SemanticAnalyzer::isTempName(def.result)) continue;
+
+        for (size_t j = i + 1; j < code.size(); j++) {
+            // 离开基本块则放弃
+            if (targets[j] || isJump(code[j - 1].op)) break;
+
+            Quadruple& use = code[j];
+            if (use.arg1 != def.result && use.arg2 != def.result) {
+                if (!isJump(use.op) && use.result == def.result) break;
+                continue;
+            }
+            if (liveAfter[j].count(def.result) && (isJump(use.op) || use.result != def.result)) break;
+
+            if (use.arg1 == def.result) use.arg1 = def.arg1;
+            if (use.arg2 == def.result) use.arg2 = def.arg1;
+            dead[i] = true;
+            st.propagated++;
+            changed = true;
+            break;
+        }
+    }
+    if (changed) compact();
+    return changed;
+}
+
+// t = a + b; x = t  =>  x = a + b（t之后不再活跃）
+bool Optimizer::propagateCopies(OptimizeStats& st) {
+    vector<set<string>> liveAfter = liveness();
+    vector<bool> targets = jumpTargets();
+
+    bool changed = false;
+    for (size_t i = 0; i + 1 < code.size(); i++) {
+        Quadruple& def = code[i];
+        Quadruple& copy = code[i + 1];
+        if (dead[i] || isJump(def.op) || !SemanticAnalyzer::isTempName(def.result)) continue;
+        if (copy.op != "=" || copy.arg1 != def.result || targets[i + 1]) continue;
+        if (liveAfter[i + 1].count(def.result) && copy.result != def.result) continue;
+
+        def.result = copy.result;
+        dead[i + 1] = true;
+        st.propagated++;
+        changed = true;
+        i++;
+    }
+    if (changed) compact();
+    return changed;
+}
+
+// goto L1; ... L1: goto L2  =>  goto L2
+bool Optimizer::threadJumps(OptimizeStats& st) {
+    bool changed = false;
+    int n = code.size();
+    for (int i = 0; i < n; i++) {
+        int t = targetIndex(code[i]);
+        if (t < 0) continue;
+
+        int dest = t;
+        int hops = 0;
+        while (dest < n && code[dest].op == "j" && hops < n) {
+            int next = targetIndex(code[dest]);
+            if (next < 0 || next == dest) break;
+            dest = next;
+            hops++;
+        }
+        if (dest != t) {
+            code[i].result = to_string(base + dest);
+            st.threaded++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// 删除跳向下一条指令的跳转；if c goto L+2; goto M; L+2: ...  =>  if !c goto M
+bool Optimizer::removeJumpsToNext(OptimizeStats& st) {
+    static const map<string, string> NEGATE = {
+        { "j>", "j<=" }, { "j<=", "j>" }, { "j<", "j>=" },
+        { "j>=", "j<" }, { "j==", "j!=" }, { "j!=", "j==" }
+    };
+
+    vector<bool> targets = jumpTargets();
+    bool changed = false;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (dead[i]) continue;
+        int t = targetIndex(code[i]);
+        if (t < 0) continue;
+
+        if (t == (int)i + 1) {
+            dead[i] = true;
+            st.jumpsRemoved++;
+            changed = true;
+            continue;
+        }
+
+        auto neg = NEGATE.find(code[i].op);
+        if (neg != NEGATE.end() && t == (int)i + 2 && code[i + 1].op == "j" && !targets[i + 1]) {
+            code[i].op = neg->second;
+            code[i].result = code[i + 1].result;
+            dead[i + 1] = true;
+            st.jumpsRemoved++;
+            changed = true;
+        }
+    }
+    if (changed) compact();
+    return changed;
+}
+
+vector<BasicBlock> Optimizer::buildCFG() const {
+    int n = code.size();
+
+    // 首条指令、跳转目标、跳转的下一条指令都是基本块入口
+    vector<bool> leader = jumpTargets();
+    if (n > 0) leader[0] = true;
+    for (int i = 0; i < n; i++) {
+        if (isJump(code[i].op)) leader[i + 1] = true;
+    }
+
+    vector<BasicBlock> blocks;
+    vector<int> blockOf(n + 1, -1);     // 入口指令所在的块，blockOf[n]为出口
+    for (int i = 0; i < n; i++) {
+        if (leader[i]) blocks.push_back(BasicBlock(i, i));
+        blocks.back().end = i + 1;
+        blockOf[i] = blocks.size() - 1;
+    }
+
+    for (size_t b = 0; b < blocks.size(); b++) {
+        const Quadruple& last = code[blocks[b].end - 1];
+        int t = targetIndex(last);
+        if (t >= 0) {
+            blocks[b].succ.push_back(blockOf[t]);
+        }
+        // 无条件跳转之外都可以顺序执行到下一块
+        if (last.op != "j" || t < 0) {
+            int next = blockOf[blocks[b].end];
+            if (find(blocks[b].succ.begin(), blocks[b].succ.end(), next) == blocks[b].succ.end()) {
+                blocks[b].succ.push_back(next);
+            }
+        }
+        for (int s : blocks[b].succ) {
+            if (s >= 0) blocks[s].pred.push_back(b);
+        }
+    }
+    return blocks;
+}
+
+void Optimizer::printCFG(const vector<BasicBlock>& blocks, OutputSink& sink) const {
+    sink.message("\n基本块与控制流图：");
+    string line;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        line = "  B" + to_string(b) + " [" + to_string(base + blocks[b].begin) + ", "
+            + to_string(base + blocks[b].end - 1) + "] →";
+        for (int s : blocks[b].succ) {
+            if (s < 0) line += " 出口";
+            else line += " B" + to_string(s);
+        }
+        sink.message(line);
+    }
+}
+
+// 从入口块出发不可达的块整块删除（如折叠后恒真/恒假条件跳过的分支）
+bool Optimizer::removeUnreachable(OptimizeStats& st) {
+    vector<BasicBlock> blocks = buildCFG();
+    if (blocks.empty()) return false;
+
+    vector<bool> reached(blocks.size(), false);
+    vector<int> work(1, 0);
+    reached[0] = true;
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        for (int s : blocks[b].succ) {
+            if (s >= 0 && !reached[s]) {
+                reached[s] = true;
+                work.push_back(s);
+            }
+        }
+    }
+
+    bool changed = false;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (reached[b]) continue;
+        for (int i = blocks[b].begin; i < blocks[b].end; i++) {
+            dead[i] = true;
+            st.unreachable++;
+        }
+        changed = true;
+    }
+    if (changed) compact();
+    return changed;
+}
+
+// 活跃变量分析：程序变量在出口处活跃（即程序的输出），临时变量不活跃
+vector<set<string>> Optimizer::liveness() const {
+    vector<BasicBlock> blocks = buildCFG();
+    vector<set<string>> liveAfter(code.size());
+    if (blocks.empty()) return liveAfter;
+
+    set<string> exitLive;
+    for (const Quadruple& q : code) {
+        if (!isJump(q.op) && !SemanticAnalyzer::isTempName(q.result)) exitLive.insert(q.result);
+    }
+
+    // 逆序扫描一个块，由块出口处的活跃集合求入口处的活跃集合
+    auto scanBlock = [&](const BasicBlock& blk, set<string> live, bool record) {
+        for (int i = blk.end - 1; i >= blk.begin; i--) {
+            const Quadruple& q = code[i];
+            if (record) liveAfter[i] = live;
+            if (!isJump(q.op)) live.erase(q.result);
+            if (!q.arg1.empty() && q.arg1 != "_" && !isNumber(q.arg1)) live.insert(q.arg1);
+            if (!q.arg2.empty() && q.arg2 != "_" && !isNumber(q.arg2)) live.insert(q.arg2);
+        }
+        return live;
+    };
+
+    auto liveOut = [&](const BasicBlock& blk, const vector<set<string>>& liveIn) {
+        set<string> out;
+        for (int s : blk.succ) {
+            const set<string>& in = s >= 0 ? liveIn[s] : exitLive;
+            out.insert(in.begin(), in.end());
+        }
+        return out;
+    };
+
+    vector<set<string>> liveIn(blocks.size());
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = (int)blocks.size() - 1; b >= 0; b--) {
+            set<string> in = scanBlock(blocks[b], liveOut(blocks[b], liveIn), false);
+            if (in != liveIn[b]) {
+                liveIn[b].swap(in);
+                changed = true;
+            }
+        }
+    }
+
+    for (const BasicBlock& blk : blocks) {
+        scanBlock(blk, liveOut(blk, liveIn), true);
+    }
+    return liveAfter;
+}
+
+// 删除结果在之后不再被读取的赋值
+bool Optimizer::removeDeadStores(OptimizeStats& st) {
+    vector<set<string>> liveAfter = liveness();
+
+    bool changed = false;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (isJump(code[i].op) || liveAfter[i].count(code[i].result)) continue;
+        // 可能出错（除数为零，或INT64_MIN / -1）的除法会使程序出错结束，即使结果无用也要保留
+        long long divisor;
+        if (code[i].op == "/" && (!toInt64(code[i].arg2, divisor) || divisor == 0 || divisor == -1)) continue;
+        dead[i] = true;
+        st.deadStores++;
+        changed = true;
+    }
+    if (changed) compact();
+    return changed;
+}
+
+bool Optimizer::peepholeRound(OptimizeStats& st) {
+    bool changed = false;
+    changed |= foldConstants(st);
+    changed |= propagateConstants(st);
+    changed |= propagateCopies(st);
+    changed |= threadJumps(st);
+    changed |= removeJumpsToNext(st);
+    return changed;
+}
+
+bool Optimizer::deadCodeRound(OptimizeStats& st) {
+    bool changed = false;
+    changed |= removeUnreachable(st);
+    changed |= removeDeadStores(st);
+    return changed;
+}
+
+OptimizeStats Optimizer::peephole() {
+    OptimizeStats st;
+    dead.assign(code.size(), false);
+    while (peepholeRound(st)) {}
+    return st;
+}
+
+OptimizeStats Optimizer::eliminateDeadCode() {
+    OptimizeStats st;
+    dead.assign(code.size(), false);
+    while (deadCodeRound(st)) {}
+    return st;
+}
+
+OptimizeStats Optimizer::run() {
+    OptimizeStats st;
+    dead.assign(code.size(), false);
+    bool changed = true;
+    while (changed) {
+        changed = peepholeRound(st);
+        changed |= deadCodeRound(st);
+    }
+    return st;
+}
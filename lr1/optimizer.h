@@ -0,0 +1,78 @@
+#pragma once
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "common.h"
+#include "output.h"
+
+// ==================== 优化统计 ====================
+struct OptimizeStats {
+    int folded;         // 常量折叠的指令数
+    int propagated;     // 复制/常量传播消去的指令数
+    int threaded;       // 跳转链被缩短的跳转数
+    int jumpsRemoved;   // 删除的无用跳转数
+    int unreachable;    // 删除的不可达指令数
+    int deadStores;     // 删除的无用赋值数
+
+    OptimizeStats() : folded(0), propagated(0), threaded(0), jumpsRemoved(0),
+        unreachable(0), deadStores(0) {}
+};
+
+// ==================== 基本块 ====================
+struct BasicBlock {
+    int begin, end;         // 指令下标范围 [begin, end)
+    vector<int> succ;       // 后继块编号，-1表示程序出口
+    vector<int> pred;       // 前驱块编号
+
+    BasicBlock(int b, int e) : begin(b), end(e) {}
+};
+
+// ==================== 中间代码优化器 ====================
+// 直接在四元式序列上原位修改，跳转目标为绝对地址（首条指令地址为base）
+class Optimizer {
+private:
+    QuadList& code;
+    int base;
+
+    vector<bool> dead;          // 标记待删除的指令
+
+    static bool isJump(const string& op) { return !op.empty() && op[0] == 'j'; }
+    static bool isNumber(const string& s);
+    static bool toInt64(const string& s, long long& value);
+
+    int targetIndex(const Quadruple& q) const;  // 跳转目标的下标，越界时返回-1
+    vector<bool> jumpTargets() const;           // 各指令是否为某条跳转的目标
+    vector<set<string>> liveness() const;       // 各指令执行后的活跃变量
+
+    bool foldConstants(OptimizeStats& st);
+    bool propagateConstants(OptimizeStats& st);
+    bool propagateCopies(OptimizeStats& st);
+    bool threadJumps(OptimizeStats& st);
+    bool removeJumpsToNext(OptimizeStats& st);
+
+    bool removeUnreachable(OptimizeStats& st);
+    bool removeDeadStores(OptimizeStats& st);
+
+    bool peepholeRound(OptimizeStats& st);
+    bool deadCodeRound(OptimizeStats& st);
+
+    void compact();             // 删除dead指令并修正跳转目标
+
+public:
+    Optimizer(QuadList& c, int baseAddr = 100);
+
+    // 按跳转目标和跳转指令划分基本块并连接控制流边
+    vector<BasicBlock> buildCFG() const;
+    void printCFG(const vector<BasicBlock>& blocks, OutputSink& sink) const;
+
+    // 反复执行各项窥孔变换直到不再变化
+    OptimizeStats peephole();
+
+    // 删除不可达的基本块及结果不再被读取的赋值
+    OptimizeStats eliminateDeadCode();
+
+    // 交替执行窥孔优化与死代码删除直到不再变化
+    OptimizeStats run();
+};
+
+#endif
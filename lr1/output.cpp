@@ -0,0 +1,474 @@
+#include "output.h"
+#include "lr1_parser.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX        // 避免与std::min/max冲突
+#include <windows.h>
+#else
+#include <iconv.h>
+#endif
+
+// 两位一组查表，减少除法次数
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+int formatInt(int64_t v, char* buf) {
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    // 取绝对值时转为无符号，INT64_MIN也不会溢出
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    while (u >= 100) {
+        unsigned pair = (unsigned)(u % 100) * 2;
+        u /= 100;
+        *--p = DIGIT_PAIRS[pair + 1];
+        *--p = DIGIT_PAIRS[pair];
+    }
+    if (u >= 10) {
+        *--p = DIGIT_PAIRS[u * 2 + 1];
+        *--p = DIGIT_PAIRS[u * 2];
+    }
+    else {
+        *--p = (char)('0' + u);
+    }
+    if (v < 0) *--p = '-';
+
+    int n = (int)(tmp + sizeof(tmp) - p);
+    memcpy(buf, p, n);
+    return n;
+}
+
+// ==================== BufferedWriter ====================
+
+BufferedWriter::BufferedWriter(FILE* f, size_t capacity) : file(f), buffer(max(capacity, (size_t)64)), used(0) {}
+
+BufferedWriter::~BufferedWriter() {
+    flush();
+}
+
+void BufferedWriter::write(const char* s, size_t n) {
+    if (used + n > buffer.size()) {
+        flush();
+        // 比缓冲区还大的内容直接写出
+        if (n > buffer.size()) {
+            fwrite(s, 1, n, file);
+            return;
+        }
+    }
+    memcpy(buffer.data() + used, s, n);
+    used += n;
+}
+
+void BufferedWriter::writeInt(int64_t v) {
+    char buf[20];
+    write(buf, formatInt(v, buf));
+}
+
+void BufferedWriter::pad(string_view s, int width) {
+    for (int i = (int)s.size(); i < width; i++) put(' ');
+    write(s);
+}
+
+void BufferedWriter::padInt(int64_t v, int width) {
+    char buf[20];
+    int n = formatInt(v, buf);
+    pad(string_view(buf, n), width);
+}
+
+void BufferedWriter::flush() {
+    if (used > 0) fwrite(buffer.data(), 1, used, file);
+    used = 0;
+    fflush(file);
+}
+
+// ==================== OutputSink ====================
+
+unique_ptr<OutputSink> OutputSink::create(OutputFormat format, FILE* file) {
+    switch (format) {
+    case OUTPUT_TEXT: return unique_ptr<OutputSink>(new TextSink(file));
+    case OUTPUT_JSONL: return unique_ptr<OutputSink>(new JsonLinesSink(file));
+    case OUTPUT_BINARY: return unique_ptr<OutputSink>(new BinarySink(file));
+    case OUTPUT_NONE: break;
+    }
+    return unique_ptr<OutputSink>(new NullSink());
+}
+
+// ==================== TextSink ====================
+
+TextSink::TextSink(FILE* file, FILE* errors) : out(file), errFile(errors) {}
+
+void TextSink::message(string_view text) {
+    out.write(text);
+    out.put('\n');
+}
+
+void TextSink::tokens(const TokenList& tokens) {
+    out.write("\n===================== 词法分析结果 =====================\n");
+    out.pad("序号", 8);
+    out.pad("类别码", 12);
+    out.pad("类别名", 12);
+    out.pad("值", 12);
+    out.pad("行号", 8);
+    out.write("\n--------------------------------------------------------\n");
+
+    for (size_t i = 0; i < tokens.size(); i++) {
+        out.padInt(i, 8);
+        out.padInt(tokens[i].type, 12);
+        out.pad(tokenTypeToString(tokens[i].type), 12);
+        out.pad(tokens[i].value, 12);
+        out.padInt(tokens[i].line, 8);
+        out.put('\n');
+    }
+    out.write("========================================================\n\n");
+}
+
+void TextSink::traceHeader() {
+    out.write("\nLR(1)分析过程：\n");
+    out.pad("步骤", 6);
+    out.pad("状态栈", 20);
+    out.pad("符号栈", 25);
+    out.pad("当前输入", 18);
+    out.pad("动作", 12);
+    out.put('\n');
+    out.write(string(81, '-'));
+    out.put('\n');
+}
+
+void TextSink::traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>& symbols,
+    const Token& lookahead, int action, const Production* reduced) {
+    out.padInt(step, 6);
+
+    // 栈内容过长时截断，够长后不再拼接，深栈时每步的开销不随栈深增长
+    char buf[20];
+    line.clear();
+    for (size_t i = 0; i < states.size() && line.size() < 18; i++) {
+        line.append(buf, formatInt(states[i], buf));
+        line += ' ';
+    }
+    out.pad(string_view(line).substr(0, 18), 20);
+
+    line.clear();
+    for (size_t i = 0; i < symbols.size() && line.size() < 23; i++) {
+        line += symbols[i];
+        line += ' ';
+    }
+    out.pad(string_view(line).substr(0, 23), 25);
+    out.pad(lookahead.value, 18);
+
+    if (action == ACTION_ERROR) {
+        out.pad("错误", 12);
+    }
+    else {
+        out.pad(LR1Parser::actionToString(action), 12);
+    }
+    if (reduced != nullptr) {
+        out.write(" (");
+        out.write(reduced->left);
+        out.write("→");
+        for (size_t i = 0; i < reduced->right.size(); i++) {
+            if (i > 0) out.put(' ');
+            out.write(reduced->right[i]);
+        }
+        out.put(')');
+    }
+    out.put('\n');
+}
+
+void TextSink::code(const QuadList& code, int base) {
+    out.write("\n==================== 三地址码 ====================\n");
+
+    for (size_t i = 0; i < code.size(); i++) {
+        const Quadruple& q = code[i];
+        out.put('(');
+        out.writeInt(base + i);
+        out.write(") ");
+
+        if (q.op == "j") {
+            out.write("goto ");
+            out.write(q.result);
+        }
+        else if (q.op.length() > 1 && q.op[0] == 'j') {
+            // 条件跳转 j>, j<, j>=, j<=, j==, j!=
+            out.write("if ");
+            out.write(q.arg1);
+            out.put(' ');
+            out.write(string_view(q.op).substr(1));
+            out.put(' ');
+            out.write(q.arg2);
+            out.write(" goto ");
+            out.write(q.result);
+        }
+        else if (q.op == "=") {
+            out.write(q.result);
+            out.write(" = ");
+            out.write(q.arg1);
+        }
+        else {
+            // 算术运算
+            out.write(q.result);
+            out.write(" = ");
+            out.write(q.arg1);
+            out.put(' ');
+            out.write(q.op);
+            out.put(' ');
+            out.write(q.arg2);
+        }
+        out.put('\n');
+    }
+
+    out.write("=================================================\n\n");
+}
+
+void TextSink::diagnostics(const vector<Diagnostic>& list) {
+    // 先写出已缓冲的正常输出，保持先后顺序
+    out.flush();
+    BufferedWriter err(errFile, 4096);
+    err.write("\n发现 ");
+    err.writeInt(list.size());
+    err.write(" 个错误：\n");
+    for (const Diagnostic& d : list) {
+        err.write("  第 ");
+        err.writeInt(d.line);
+        err.write(" 行：");
+        err.write(d.message);
+        err.put('\n');
+    }
+}
+
+void TextSink::flush() {
+    out.flush();
+}
+
+// ==================== JsonLinesSink ====================
+
+JsonLinesSink::JsonLinesSink(FILE* file) : out(file) {}
+
+// 把一个GBK双字节字符解码为UTF-16码元（GBK字符都在基本多文种平面内），无法解码时返回0xFFFD
+static unsigned decodeGbk(unsigned char lead, unsigned char trail) {
+    char bytes[2] = { (char)lead, (char)trail };
+#ifdef _WIN32
+    wchar_t w;
+    if (MultiByteToWideChar(936, MB_ERR_INVALID_CHARS, bytes, 2, &w, 1) == 1) return w;
+#else
+    // iconv句柄不能跨线程共用，每个线程打开一个
+    thread_local struct Converter {
+        iconv_t cd;
+        Converter() : cd(iconv_open("UTF-16LE", "GBK")) {}
+        ~Converter() { if (cd != (iconv_t)-1) iconv_close(cd); }
+    } conv;
+    unsigned char unit[4];
+    char* in = bytes;
+    char* outp = (char*)unit;
+    size_t inLeft = 2, outLeft = sizeof(unit);
+    if (conv.cd != (iconv_t)-1 && iconv(conv.cd, &in, &inLeft, &outp, &outLeft) != (size_t)-1 && outLeft == 2) {
+        return unit[0] | (unit[1] << 8);
+    }
+    if (conv.cd != (iconv_t)-1) iconv(conv.cd, nullptr, nullptr, nullptr, nullptr);     // 出错后复位转换状态
+#endif
+    return 0xFFFD;
+}
+
+int jsonEscapeChar(string_view s, size_t& i, char* buf) {
+    static const char HEX[] = "0123456789abcdef";
+    char c = s[i];
+    unsigned char u = (unsigned char)c;
+    unsigned code = u;
+    if (u >= 0x80) {
+        // GBK的尾字节可能落在ASCII范围（如'\\'），必须与首字节一起解码
+        code = 0xFFFD;
+        if (u >= 0x81 && u <= 0xFE && i + 1 < s.size()) {
+            unsigned char trail = (unsigned char)s[i + 1];
+            if (trail >= 0x40 && trail <= 0xFE && trail != 0x7F) {
+                code = decodeGbk(u, trail);
+                i++;
+            }
+        }
+    }
+    else if (c == '"' || c == '\\') {
+        buf[0] = '\\';
+        buf[1] = c;
+        return 2;
+    }
+    else if (c == '\n') {
+        buf[0] = '\\';
+        buf[1] = 'n';
+        return 2;
+    }
+    else if (u >= 0x20) {
+        buf[0] = c;
+        return 1;
+    }
+    char esc[] = { '\\', 'u', HEX[code >> 12], HEX[(code >> 8) & 15], HEX[(code >> 4) & 15], HEX[code & 15] };
+    memcpy(buf, esc, sizeof(esc));
+    return sizeof(esc);
+}
+
+string jsonEscape(string_view s) {
+    string result;
+    result.reserve(s.size());
+    char buf[6];
+    for (size_t i = 0; i < s.size(); i++) {
+        result.append(buf, jsonEscapeChar(s, i, buf));
+    }
+    return result;
+}
+
+void JsonLinesSink::quoted(string_view s) {
+    out.put('"');
+    char buf[6];
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char u = (unsigned char)s[i];
+        // 常见的可打印ASCII直接写出
+        if (u >= 0x20 && u < 0x80 && u != '"' && u != '\\') out.put(s[i]);
+        else out.write(buf, jsonEscapeChar(s, i, buf));
+    }
+    out.put('"');
+}
+
+void JsonLinesSink::message(string_view text) {
+    out.write("{\"type\":\"message\",\"text\":");
+    quoted(text);
+    out.write("}\n");
+}
+
+void JsonLinesSink::tokens(const TokenList& tokens) {
+    for (size_t i = 0; i < tokens.size(); i++) {
+        out.write("{\"type\":\"token\",\"index\":");
+        out.writeInt(i);
+        out.write(",\"kind\":");
+        quoted(tokenTypeToString(tokens[i].type));
+        out.write(",\"value\":");
+        quoted(tokens[i].value);
+        out.write(",\"line\":");
+        out.writeInt(tokens[i].line);
+        out.write("}\n");
+    }
+}
+
+void JsonLinesSink::traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>& symbols,
+    const Token& lookahead, int action, const Production* reduced) {
+    out.write("{\"type\":\"step\",\"step\":");
+    out.writeInt(step);
+    out.write(",\"state\":");
+    out.writeInt(states.back());
+    out.write(",\"depth\":");
+    out.writeInt(states.size());
+    out.write(",\"symbol\":");
+    quoted(symbols.back());
+    out.write(",\"input\":");
+    quoted(lookahead.value);
+    out.write(",\"action\":");
+    quoted(action == ACTION_ERROR ? "error" : LR1Parser::actionToString(action));
+    if (reduced != nullptr) {
+        out.write(",\"lhs\":");
+        quoted(reduced->left);
+        out.write(",\"rhs\":[");
+        for (size_t i = 0; i < reduced->right.size(); i++) {
+            if (i > 0) out.put(',');
+            quoted(reduced->right[i]);
+        }
+        out.put(']');
+    }
+    out.write("}\n");
+}
+
+void JsonLinesSink::code(const QuadList& code, int base) {
+    for (size_t i = 0; i < code.size(); i++) {
+        const Quadruple& q = code[i];
+        out.write("{\"type\":\"quad\",\"addr\":");
+        out.writeInt(base + i);
+        out.write(",\"op\":");
+        quoted(q.op);
+        out.write(",\"arg1\":");
+        quoted(q.arg1);
+        out.write(",\"arg2\":");
+        quoted(q.arg2);
+        out.write(",\"result\":");
+        quoted(q.result);
+        out.write("}\n");
+    }
+}
+
+void JsonLinesSink::diagnostics(const vector<Diagnostic>& list) {
+    for (const Diagnostic& d : list) {
+        out.write("{\"type\":\"diagnostic\",\"line\":");
+        out.writeInt(d.line);
+        out.write(",\"message\":");
+        quoted(d.message);
+        out.write("}\n");
+    }
+}
+
+void JsonLinesSink::flush() {
+    out.flush();
+}
+
+// ==================== BinarySink ====================
+
+BinarySink::BinarySink(FILE* file) : out(file) {
+    out.write("LR1S", 4);
+    out.put(1);
+}
+
+void BinarySink::varint(uint64_t v) {
+    while (v >= 0x80) {
+        out.put((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.put((char)v);
+}
+
+void BinarySink::bytes(string_view s) {
+    varint(s.size());
+    out.write(s);
+}
+
+void BinarySink::message(string_view text) {
+    out.put(REC_MESSAGE);
+    bytes(text);
+}
+
+void BinarySink::tokens(const TokenList& tokens) {
+    for (const Token& t : tokens) {
+        out.put(REC_TOKEN);
+        varint(t.type);
+        varint(t.line);
+        bytes(t.value);
+    }
+}
+
+void BinarySink::traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>&,
+    const Token& lookahead, int action, const Production*) {
+    out.put(REC_STEP);
+    varint(step);
+    svarint(action);
+    varint(states.back());
+    varint(states.size());
+    bytes(lookahead.value);
+}
+
+void BinarySink::code(const QuadList& code, int base) {
+    for (size_t i = 0; i < code.size(); i++) {
+        const Quadruple& q = code[i];
+        out.put(REC_QUAD);
+        varint(base + i);
+        bytes(q.op);
+        bytes(q.arg1);
+        bytes(q.arg2);
+        bytes(q.result);
+    }
+}
+
+void BinarySink::diagnostics(const vector<Diagnostic>& list) {
+    for (const Diagnostic& d : list) {
+        out.put(REC_DIAGNOSTIC);
+        varint(d.line);
+        bytes(d.message);
+    }
+}
+
+void BinarySink::flush() {
+    out.flush();
+}
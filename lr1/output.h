@@ -0,0 +1,170 @@
+#pragma once
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "common.h"
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+
+// 整数转十进制文本，buf至少20字节，返回字符数
+int formatInt(int64_t v, char* buf);
+
+// 把s[i]处的一个字符按JSON字符串转义写入buf（至少6字节），返回字符数。
+// 结果只含ASCII：非ASCII字符按GBK解码为\uXXXX并一并跳过尾字节（i指向已处理的最后一个字节），
+// 无法解码的字节写成\ufffd
+int jsonEscapeChar(string_view s, size_t& i, char* buf);
+// 整个字符串转义后的内容（不含两端引号）
+string jsonEscape(string_view s);
+
+// ==================== 缓冲写出 ====================
+// 攒满缓冲区（或显式flush）才写到文件，不按行刷新，不经过iostream
+class BufferedWriter {
+private:
+    FILE* file;
+    vector<char> buffer;
+    size_t used;
+
+public:
+    explicit BufferedWriter(FILE* f, size_t capacity = 64 * 1024);
+    ~BufferedWriter();
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void write(const char* s, size_t n);
+    void write(string_view s) { write(s.data(), s.size()); }
+    void put(char c) {
+        if (used == buffer.size()) flush();
+        buffer[used++] = c;
+    }
+    void writeInt(int64_t v);
+    // 右对齐到width字节（与setw相同，按字节计宽度）
+    void pad(string_view s, int width);
+    void padInt(int64_t v, int width);
+    void flush();
+};
+
+// 输出格式
+enum OutputFormat {
+    OUTPUT_TEXT,        // 供人阅读的表格
+    OUTPUT_JSONL,       // 每条记录一行JSON
+    OUTPUT_BINARY,      // 紧凑的二进制记录
+    OUTPUT_NONE         // 不输出
+};
+
+// ==================== 输出接口 ====================
+// 编译过程的输出都经过这里，由具体实现决定格式和去向
+class OutputSink {
+public:
+    virtual ~OutputSink() {}
+
+    // 为false时调用者可以跳过输出内容的整理
+    virtual bool enabled() const { return true; }
+
+    virtual void message(string_view text) = 0;     // 一行说明文字
+    virtual void tokens(const TokenList& tokens) = 0;
+    virtual void traceHeader() = 0;
+    // 分析的一步：reduced为归约所用的产生式，其他动作为nullptr
+    virtual void traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>& symbols,
+        const Token& lookahead, int action, const Production* reduced) = 0;
+    virtual void code(const QuadList& code, int base) = 0;
+    virtual void diagnostics(const vector<Diagnostic>& list) = 0;
+    virtual void flush() = 0;
+
+    // 写到file的各格式实现，OUTPUT_NONE返回NullSink
+    static unique_ptr<OutputSink> create(OutputFormat format, FILE* file);
+};
+
+class NullSink : public OutputSink {
+public:
+    bool enabled() const override { return false; }
+    void message(string_view) override {}
+    void tokens(const TokenList&) override {}
+    void traceHeader() override {}
+    void traceStep(int, const pmr::vector<int>&, const pmr::vector<string>&, const Token&, int,
+        const Production*) override {}
+    void code(const QuadList&, int) override {}
+    void diagnostics(const vector<Diagnostic>&) override {}
+    void flush() override {}
+};
+
+// 原有的表格格式；诊断写到errFile
+class TextSink : public OutputSink {
+private:
+    BufferedWriter out;
+    FILE* errFile;
+    string line;        // 拼接分析栈用，复用容量
+
+public:
+    explicit TextSink(FILE* file = stdout, FILE* errors = stderr);
+
+    void message(string_view text) override;
+    void tokens(const TokenList& tokens) override;
+    void traceHeader() override;
+    void traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>& symbols,
+        const Token& lookahead, int action, const Production* reduced) override;
+    void code(const QuadList& code, int base) override;
+    void diagnostics(const vector<Diagnostic>& list) override;
+    void flush() override;
+};
+
+// 每行一个JSON对象，"type"为 message / token / step / quad / diagnostic。
+// 分析步骤只记录栈顶和栈深度，完整的栈可由移进/归约序列还原，输出量与步数成正比。
+// 输出只含ASCII：程序的提示和诊断是GBK编码，字符串中的非ASCII字符按GBK解码后写成\uXXXX，
+// 无法解码的字节（如源码中的其他编码）写成\ufffd，因此无论读取方按何种编码打开都是合法的JSON
+class JsonLinesSink : public OutputSink {
+private:
+    BufferedWriter out;
+
+    void quoted(string_view s);     // 写出带引号并转义的JSON字符串
+
+public:
+    explicit JsonLinesSink(FILE* file);
+
+    void message(string_view text) override;
+    void tokens(const TokenList& tokens) override;
+    void traceHeader() override {}
+    void traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>& symbols,
+        const Token& lookahead, int action, const Production* reduced) override;
+    void code(const QuadList& code, int base) override;
+    void diagnostics(const vector<Diagnostic>& list) override;
+    void flush() override;
+};
+
+// 二进制记录：开头为 "LR1S" 和版本号1，之后每条记录一个类型字节加若干字段。
+// 整数为LEB128变长编码（有符号数先做zigzag），字符串为长度加字节
+//   1 message     文本
+//   2 token       类别码、行号、值
+//   3 step        步骤、动作、栈顶状态、栈深度、当前单词
+//   4 quad        地址、op、arg1、arg2、result
+//   5 diagnostic  行号、信息
+class BinarySink : public OutputSink {
+private:
+    BufferedWriter out;
+
+    void varint(uint64_t v);
+    void svarint(int64_t v) { varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+    void bytes(string_view s);
+
+public:
+    enum Record : uint8_t {
+        REC_MESSAGE = 1,
+        REC_TOKEN = 2,
+        REC_STEP = 3,
+        REC_QUAD = 4,
+        REC_DIAGNOSTIC = 5
+    };
+
+    explicit BinarySink(FILE* file);
+
+    void message(string_view text) override;
+    void tokens(const TokenList& tokens) override;
+    void traceHeader() override {}
+    void traceStep(int step, const pmr::vector<int>& states, const pmr::vector<string>& symbols,
+        const Token& lookahead, int action, const Production* reduced) override;
+    void code(const QuadList& code, int base) override;
+    void diagnostics(const vector<Diagnostic>& list) override;
+    void flush() override;
+};
+
+#endif
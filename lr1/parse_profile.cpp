@@ -0,0 +1,88 @@
+#include "parse_profile.h"
+#include "lr1_parser.h"
+
+void ParseProfile::prepare(const LR1Parser& parser) {
+    if (grammarHash == parser.getGrammarHash() && stateCount == parser.getStateCount() &&
+        terminalCount == parser.terminalCount() && nonTerminalCount == parser.nonTerminalCount()) {
+        return;
+    }
+    grammarHash = parser.getGrammarHash();
+    stateCount = parser.getStateCount();
+    terminalCount = parser.terminalCount();
+    nonTerminalCount = parser.nonTerminalCount();
+    actions.assign((size_t)stateCount * terminalCount, 0);
+    gotos.assign((size_t)stateCount * nonTerminalCount, 0);
+}
+
+uint64_t ParseProfile::total() const {
+    uint64_t sum = 0;
+    for (uint64_t c : actions) sum += c;
+    for (uint64_t c : gotos) sum += c;
+    return sum;
+}
+
+bool ParseProfile::save(const LR1Parser& parser, const string& path, string& error) const {
+    ofstream out(path);
+    out << "LR1P 1 " << grammarHash << " " << stateCount << "\n";
+    for (int s = 0; s < stateCount; s++) {
+        int origin = parser.originalState(s);
+        for (int t = 0; t < terminalCount; t++) {
+            uint64_t c = actionCount(s, t);
+            if (c > 0) out << "a " << origin << " " << parser.terminalName(t) << " " << c << "\n";
+        }
+        for (int n = 0; n < nonTerminalCount; n++) {
+            uint64_t c = gotoCount(s, n);
+            if (c > 0) out << "g " << origin << " " << parser.nonTerminalName(n) << " " << c << "\n";
+        }
+    }
+    out.close();
+    if (!out) {
+        error = "无法写入剖析文件：" + path;
+        return false;
+    }
+    return true;
+}
+
+bool ParseProfile::load(const LR1Parser& parser, const string& path, string& error) {
+    ifstream in(path);
+    if (!in.is_open()) {
+        error = "无法打开剖析文件：" + path;
+        return false;
+    }
+
+    string magic, hash;
+    int version = 0, states = 0;
+    in >> magic >> version >> hash >> states;
+    if (!in || magic != "LR1P" || version != 1) {
+        error = "剖析文件格式错误：" + path;
+        return false;
+    }
+    if (hash != parser.getGrammarHash() || states != parser.getStateCount()) {
+        error = "剖析文件与当前文法不一致：" + path;
+        return false;
+    }
+
+    grammarHash.clear();
+    prepare(parser);
+
+    string kind, symbol;
+    int state;
+    uint64_t count;
+    int lineNo = 1;
+    while (in >> kind >> state >> symbol >> count) {
+        lineNo++;
+        bool isAction = kind == "a";
+        int id = isAction ? parser.terminalId(symbol) : parser.nonTerminalId(symbol);
+        if ((!isAction && kind != "g") || id < 0 || state < 0 || state >= stateCount) {
+            error = path + ":" + to_string(lineNo) + ": 无效的记录";
+            return false;
+        }
+        if (isAction) actions[state * terminalCount + id] += count;
+        else gotos[state * nonTerminalCount + id] += count;
+    }
+    if (!in.eof()) {
+        error = path + ":" + to_string(lineNo + 1) + ": 无效的记录";
+        return false;
+    }
+    return true;
+}
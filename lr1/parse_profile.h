@@ -0,0 +1,46 @@
+#pragma once
+#ifndef PARSE_PROFILE_H
+#define PARSE_PROFILE_H
+
+#include "common.h"
+#include <cstdint>
+
+class LR1Parser;
+
+// ==================== 分析表访问剖析 ====================
+// 记录分析过程中每个ACTION表项和GOTO表项被读取的次数，
+// 供构造分析表时按访问频度重排状态和列（LR1Parser::setProfileFile）。
+// 文件为文本格式，状态按未重排时的编号、符号按名字记录，与分析表的排列无关：
+//   LR1P 1 <文法哈希> <状态数>
+//   a <状态> <终结符> <次数>
+//   g <状态> <非终结符> <次数>
+class ParseProfile {
+private:
+    string grammarHash;
+    int stateCount;
+    int terminalCount;
+    int nonTerminalCount;
+    vector<uint64_t> actions;   // actions[状态 * 终结符数 + 终结符]，按分析器当前的编号
+    vector<uint64_t> gotos;     // gotos[状态 * 非终结符数 + 非终结符]
+
+public:
+    ParseProfile() : stateCount(0), terminalCount(0), nonTerminalCount(0) {}
+
+    // 按分析器的表尺寸清零；尺寸已一致时保留已有计数
+    void prepare(const LR1Parser& parser);
+
+    void countAction(int state, int terminal) { actions[state * terminalCount + terminal]++; }
+    void countGoto(int state, int nonTerminal) { gotos[state * nonTerminalCount + nonTerminal]++; }
+
+    uint64_t actionCount(int state, int terminal) const { return actions[state * terminalCount + terminal]; }
+    uint64_t gotoCount(int state, int nonTerminal) const { return gotos[state * nonTerminalCount + nonTerminal]; }
+    uint64_t total() const;
+    bool empty() const { return total() == 0; }
+
+    // 写出时把分析器当前的状态编号换算为未重排时的编号
+    bool save(const LR1Parser& parser, const string& path, string& error) const;
+    // 读入到未重排的分析器的编号下，文法哈希不一致时失败
+    bool load(const LR1Parser& parser, const string& path, string& error);
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include "program_image.h"
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(ImageHeader) == 64, "文件头布局不能随编译器变化");
+
+static const char IMAGE_MAGIC[4] = { 'L', 'R', '1', 'B' };
+
+ProgramImage::ProgramImage() : data(nullptr), size(0), mapping(nullptr) {}
+
+ProgramImage::~ProgramImage() {
+    unload();
+}
+
+void ProgramImage::unload() {
+#ifndef _WIN32
+    if (mapping != nullptr) munmap(mapping, size);
+#endif
+    mapping = nullptr;
+    storage.clear();
+    data = nullptr;
+    size = 0;
+}
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+string ProgramImage::serialize(const Bytecode& bc) {
+    ImageHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMAGE_MAGIC, 4);
+    h.version = IMAGE_VERSION;
+    h.headerSize = sizeof(ImageHeader);
+    h.byteOrder = IMAGE_BYTE_ORDER;
+    h.count = bc.ops.size();
+    h.namedSlots = bc.names.size();
+    h.varSlots = bc.varSlots;
+    h.constCount = bc.constants.size();
+
+    vector<uint32_t> nameIndex(1, 0);
+    string nameData;
+    for (const string& n : bc.names) {
+        nameData += n;
+        nameIndex.push_back(nameData.size());
+    }
+
+    // 依次排列各段，记下偏移
+    size_t pos = sizeof(ImageHeader);
+    auto place = [&](uint32_t& offset, size_t bytes) {
+        pos = align8(pos);
+        offset = pos;
+        pos += bytes;
+    };
+    size_t column = bc.ops.size() * sizeof(int32_t);
+    place(h.constOffset, bc.constants.size() * sizeof(int64_t));
+    place(h.aOffset, column);
+    place(h.bOffset, column);
+    place(h.cOffset, column);
+    place(h.dOffset, column);
+    place(h.opsOffset, bc.ops.size());
+    place(h.nameIndexOffset, nameIndex.size() * sizeof(uint32_t));
+    place(h.nameDataOffset, nameData.size());
+    h.fileSize = align8(pos);
+
+    string out(h.fileSize, '\0');
+    auto put = [&](uint32_t offset, const void* src, size_t bytes) {
+        if (bytes > 0) memcpy(&out[offset], src, bytes);
+    };
+    put(0, &h, sizeof(h));
+    put(h.constOffset, bc.constants.data(), bc.constants.size() * sizeof(int64_t));
+    put(h.aOffset, bc.a.data(), column);
+    put(h.bOffset, bc.b.data(), column);
+    put(h.cOffset, bc.c.data(), column);
+    put(h.dOffset, bc.d.data(), column);
+    put(h.opsOffset, bc.ops.data(), bc.ops.size());
+    put(h.nameIndexOffset, nameIndex.data(), nameIndex.size() * sizeof(uint32_t));
+    put(h.nameDataOffset, nameData.data(), nameData.size());
+    return out;
+}
+
+bool ProgramImage::write(const Bytecode& bc, const string& path, string& error) {
+    string image = serialize(bc);
+    ofstream out(path, ios::binary);
+    out.write(image.data(), image.size());
+    out.close();
+    if (!out) {
+        error = "无法写入目标文件：" + path;
+        return false;
+    }
+    return true;
+}
+
+bool ProgramImage::validate(const char* bytes, size_t length, string& error) {
+    if (length < sizeof(ImageHeader) || ((uintptr_t)bytes & 7) != 0) {
+        error = "文件太短或未对齐";
+        return false;
+    }
+    const ImageHeader& h = *(const ImageHeader*)bytes;
+    if (memcmp(h.magic, IMAGE_MAGIC, 4) != 0) {
+        error = "不是程序映像文件";
+        return false;
+    }
+    if (h.byteOrder != IMAGE_BYTE_ORDER) {
+        error = "字节序与本机不同";
+        return false;
+    }
+    if (h.version != IMAGE_VERSION || h.headerSize != sizeof(ImageHeader)) {
+        error = "不支持的版本 " + to_string(h.version);
+        return false;
+    }
+    if (h.fileSize != length) {
+        error = "文件长度与文件头不符";
+        return false;
+    }
+    if (h.count < 1 || h.namedSlots < 0 || h.varSlots < 0 || h.varSlots > h.namedSlots || h.constCount < 0) {
+        error = "文件头中的计数非法";
+        return false;
+    }
+
+    // 各段须对齐并落在文件内（用64位计算，避免溢出）
+    auto section = [&](uint32_t offset, uint64_t items, uint64_t itemSize, const char* what) {
+        if (offset % 8 != 0 || offset < sizeof(ImageHeader) || offset + items * itemSize > length) {
+            error = string(what) + "段越界";
+            return false;
+        }
+        return true;
+    };
+    uint64_t n = h.count;
+    if (!section(h.constOffset, h.constCount, sizeof(int64_t), "常量池") ||
+        !section(h.aOffset, n, sizeof(int32_t), "操作数a") ||
+        !section(h.bOffset, n, sizeof(int32_t), "操作数b") ||
+        !section(h.cOffset, n, sizeof(int32_t), "操作数c") ||
+        !section(h.dOffset, n, sizeof(int32_t), "操作数d") ||
+        !section(h.opsOffset, n, 1, "操作码") ||
+        !section(h.nameIndexOffset, (uint64_t)h.namedSlots + 1, sizeof(uint32_t), "名字索引")) {
+        return false;
+    }
+
+    const uint32_t* nameIndex = (const uint32_t*)(bytes + h.nameIndexOffset);
+    for (int32_t i = 0; i < h.namedSlots; i++) {
+        if (nameIndex[i] > nameIndex[i + 1]) {
+            error = "名字索引非法";
+            return false;
+        }
+    }
+    if (nameIndex[0] != 0 || !section(h.nameDataOffset, nameIndex[h.namedSlots], 1, "名字")) {
+        error = "名字段越界";
+        return false;
+    }
+
+    // 逐条检查指令：源操作数可以是任意槽位，目的操作数不能是常量，跳转目标须是指令下标
+    const uint8_t* ops = (const uint8_t*)(bytes + h.opsOffset);
+    const int32_t* a = (const int32_t*)(bytes + h.aOffset);
+    const int32_t* b = (const int32_t*)(bytes + h.bOffset);
+    const int32_t* c = (const int32_t*)(bytes + h.cOffset);
+    const int32_t* d = (const int32_t*)(bytes + h.dOffset);
+    int32_t slots = h.namedSlots + h.constCount;
+    auto source = [&](int32_t s) { return s >= 0 && s < slots; };
+    auto dest = [&](int32_t s) { return s >= 0 && s < h.namedSlots; };
+    auto target = [&](int32_t t) { return t >= 0 && t < h.count; };
+
+    for (int32_t i = 0; i < h.count; i++) {
+        uint8_t op = ops[i];
+        bool ok;
+        if (op == OP_HALT) ok = true;
+        else if (op == OP_MOV) ok = source(a[i]) && dest(c[i]);
+        else if (op >= OP_ADD && op <= OP_DIV) ok = source(a[i]) && source(b[i]) && dest(c[i]);
+        else if (op == OP_JMP) ok = target(c[i]);
+        else if (op >= OP_JLT && op <= OP_JNE) ok = source(a[i]) && source(b[i]) && target(c[i]);
+        else if (op >= OP_BLT && op <= OP_BNE) ok = source(a[i]) && source(b[i]) && target(c[i]) && target(d[i]);
+        else ok = false;
+
+        if (!ok) {
+            error = "第 " + to_string(i) + " 条指令非法（" + VM::opcodeName(op) + "）";
+            return false;
+        }
+    }
+    // 没有跳转能越过末尾，所以只要最后一条是halt，执行就不会越界
+    if (ops[h.count - 1] != OP_HALT) {
+        error = "程序必须以halt结束";
+        return false;
+    }
+    return true;
+}
+
+bool ProgramImage::load(const string& path, string& error) {
+    unload();
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "无法打开文件：" + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        error = "无法读取文件：" + path;
+        return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        error = "mmap失败：" + path;
+        return false;
+    }
+    mapping = p;
+    data = (const char*)p;
+    size = st.st_size;
+#else
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in.is_open()) {
+        error = "无法打开文件：" + path;
+        return false;
+    }
+    size = in.tellg();
+    storage.resize((size + 7) / 8);
+    in.seekg(0);
+    in.read((char*)storage.data(), size);
+    if (!in) {
+        storage.clear();
+        size = 0;
+        error = "无法读取文件：" + path;
+        return false;
+    }
+    data = (const char*)storage.data();
+#endif
+
+    if (!validate(data, size, error)) {
+        unload();
+        return false;
+    }
+    return true;
+}
+
+ProgramView ProgramImage::view() const {
+    const ImageHeader& h = header();
+    ProgramView v;
+    v.ops = (const uint8_t*)(data + h.opsOffset);
+    v.a = (const int32_t*)(data + h.aOffset);
+    v.b = (const int32_t*)(data + h.bOffset);
+    v.c = (const int32_t*)(data + h.cOffset);
+    v.d = (const int32_t*)(data + h.dOffset);
+    v.count = h.count;
+    v.namedSlots = h.namedSlots;
+    v.varSlots = h.varSlots;
+    v.constants = (const int64_t*)(data + h.constOffset);
+    v.constCount = h.constCount;
+    return v;
+}
+
+string_view ProgramImage::name(int slot) const {
+    const ImageHeader& h = header();
+    const uint32_t* index = (const uint32_t*)(data + h.nameIndexOffset);
+    return string_view(data + h.nameDataOffset + index[slot], index[slot + 1] - index[slot]);
+}
+
+vector<string> ProgramImage::names() const {
+    vector<string> result;
+    for (int i = 0; i < header().namedSlots; i++) {
+        result.push_back(string(name(i)));
+    }
+    return result;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef PROGRAM_IMAGE_H
+#define PROGRAM_IMAGE_H
+
+#include "common.h"
+#include "vm.h"
+
+// ==================== 程序映像文件格式 ====================
+// 字节码的二进制目标文件，按本机字节序存放，各段按8字节对齐，
+// 映射到内存后直接构造ProgramView执行，不做反序列化：
+//
+//   文件头 | 常量池(int64) | a | b | c | d (int32列) | 操作码(uint8) | 名字索引(uint32) | 名字字符
+//
+// 名字索引有namedSlots+1项，第i个槽位的名字为字符区[index[i], index[i+1])
+const uint16_t IMAGE_VERSION = 1;
+const uint32_t IMAGE_BYTE_ORDER = 0x01020304;   // 按本机字节序写入，读出不等说明字节序不同
+
+struct ImageHeader {
+    char magic[4];              // "LR1B"
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t byteOrder;
+    uint32_t fileSize;
+    int32_t count;              // 指令数
+    int32_t namedSlots;
+    int32_t varSlots;
+    int32_t constCount;
+    uint32_t constOffset;
+    uint32_t aOffset;
+    uint32_t bOffset;
+    uint32_t cOffset;
+    uint32_t dOffset;
+    uint32_t opsOffset;
+    uint32_t nameIndexOffset;
+    uint32_t nameDataOffset;
+};
+
+// ==================== 程序映像 ====================
+// 加载目标文件：POSIX上用mmap只读映射，其他平台读入对齐的缓冲区
+class ProgramImage {
+private:
+    const char* data;
+    size_t size;
+    void* mapping;              // mmap的地址，未映射时为nullptr
+    vector<int64_t> storage;    // 未映射时存放文件内容（int64保证对齐）
+
+    const ImageHeader& header() const { return *(const ImageHeader*)data; }
+    void unload();
+
+public:
+    ProgramImage();
+    ~ProgramImage();
+    ProgramImage(const ProgramImage&) = delete;
+    ProgramImage& operator=(const ProgramImage&) = delete;
+
+    // 序列化字节码；write写到文件
+    static string serialize(const Bytecode& bc);
+    static bool write(const Bytecode& bc, const string& path, string& error);
+
+    // 检查文件头、各段范围以及每条指令的操作码和操作数。
+    // VM::execute不做任何检查，来自文件的程序必须先通过校验
+    static bool validate(const char* bytes, size_t length, string& error);
+
+    // 映射并校验文件
+    bool load(const string& path, string& error);
+
+    bool loaded() const { return data != nullptr; }
+    ProgramView view() const;
+    string_view name(int slot) const;
+    vector<string> names() const;       // 全部命名槽位的名字，供VM::run使用
+    size_t bytes() const { return size; }
+};
+
+#endif
@@ -1,84 +1,139 @@
 #include "semantic.h"
 
-SemanticAnalyzer::SemanticAnalyzer() {
+SemanticAnalyzer::SemanticAnalyzer(pmr::memory_resource* mr)
+    : memory(mr), code(mr), freeTemps(mr), tempRefs(mr), valueNumber(mr), available(mr),
+    availableLog(mr), scopeMarks(mr) {
     reset();
 }
 
 void SemanticAnalyzer::reset() {
-    code.clear();
+    // clear()会保留容量，这里换成新的空表，放弃旧存储
+    code = QuadList(memory);
     nextquad = 100;
     tempCount = 0;
+    freeTemps = pmr::vector<int>(memory);
+    tempRefs = pmr::vector<int>(1, 0, memory);
+    valueNumber = pmr::unordered_map<string, int>(memory);
+    nextValueNumber = 0;
+    available = pmr::unordered_map<ExprKey, Available, ExprKeyHash>(memory);
+    availableLog = pmr::vector<ExprKey>(memory);
+    scopeMarks = pmr::vector<size_t>(memory);
+    cseHits = 0;
+    emitEnabled = true;
 }
 
 string SemanticAnalyzer::newtemp() {
-    return "t" + to_string(++tempCount);
+    int n;
+    if (!freeTemps.empty()) {
+        n = freeTemps.back();
+        freeTemps.pop_back();
+    }
+    else {
+        n = ++tempCount;
+        tempRefs.push_back(0);
+    }
+    tempRefs[n] = 1;
+    return "t" + to_string(n);
+}
+
+bool SemanticAnalyzer::isTempName(const string& s) {
+    if (s.size() < 2 || s[0] != 't') return false;
+    for (size_t i = 1; i < s.size(); i++) {
+        if (!isdigit((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+void SemanticAnalyzer::freetemp(const string& place) {
+    if (!isTempName(place)) return;
+    int n = atoi(place.c_str() + 1);
+    if (n < 1 || n > tempCount || tempRefs[n] == 0) return;
+    if (--tempRefs[n] == 0) freeTemps.push_back(n);
+}
+
+int SemanticAnalyzer::numberOf(const string& place) {
+    auto it = valueNumber.find(place);
+    if (it != valueNumber.end()) return it->second;
+    int n = nextValueNumber++;
+    valueNumber[place] = n;
+    return n;
 }
 
 int SemanticAnalyzer::emit(const string& op, const string& arg1, const string& arg2, const string& result) {
+    // 禁止生成时只推进地址，回填落在code之外会被忽略
+    if (!emitEnabled) return nextquad++;
     code.push_back(Quadruple(op, arg1, arg2, result));
+    // 赋值使结果得到新的值编号，用到旧值的表达式随之失效
+    if (op[0] != 'j') valueNumber[result] = nextValueNumber++;
     return nextquad++;
 }
 
-void SemanticAnalyzer::backpatch(int addr, int target) {
-    if (addr >= 100 && addr - 100 < (int)code.size()) {
-        code[addr - 100].result = to_string(target);
+string SemanticAnalyzer::emitExpr(const string& op, const string& a, const string& b) {
+    // 常量加'#'前缀，与变量名区分
+    int left = numberOf(isdigit((unsigned char)a[0]) ? "#" + a : a);
+    int right = numberOf(isdigit((unsigned char)b[0]) ? "#" + b : b);
+    if ((op == "+" || op == "*") && left > right) swap(left, right);
+    ExprKey key = { op[0], left, right };
+
+    auto it = available.find(key);
+    if (it != available.end() && numberOf(it->second.place) == it->second.number) {
+        // 命中：结果的临时变量可能已被释放但尚未改写，从空闲表中收回
+        string place = it->second.place;
+        int n = atoi(place.c_str() + 1);
+        if (tempRefs[n]++ == 0) {
+            freeTemps.erase(find(freeTemps.begin(), freeTemps.end(), n));
+        }
+        freetemp(b);
+        freetemp(a);
+        cseHits++;
+        return place;
     }
-}
 
-int SemanticAnalyzer::merge(int p1, int p2) {
-    if (p1 == -1) return p2;
-    if (p2 == -1) return p1;
-    return p1;  // 򻯴
+    // 先释放操作数，结果可以复用刚释放的临时变量
+    freetemp(b);
+    freetemp(a);
+    string t = newtemp();
+    emit(op, a, b, t);
+    available[key] = Available{ t, numberOf(t) };
+    availableLog.push_back(key);
+    return t;
 }
 
-void SemanticAnalyzer::printCode() {
-    cout << "\n==================== ַ ====================" << endl;
-
-    for (size_t i = 0; i < code.size(); i++) {
-        cout << "(" << (100 + i) << ") ";
-
-        const Quadruple& q = code[i];
+void SemanticAnalyzer::pushScope() {
+    scopeMarks.push_back(availableLog.size());
+}
 
-        if (q.op == "j") {
-            cout << "goto " << q.result;
-        }
-        else if (q.op.length() > 1 && q.op[0] == 'j') {
-            // ת j>, j<, j>=, j<=, j==, j!=
-            string rop = q.op.substr(1);
-            cout << "if " << q.arg1 << " " << rop << " " << q.arg2 << " goto " << q.result;
-        }
-        else if (q.op == "=") {
-            cout << q.result << " = " << q.arg1;
-        }
-        else {
-            // 
-            cout << q.result << " = " << q.arg1 << " " << q.op << " " << q.arg2;
-        }
-        cout << endl;
+void SemanticAnalyzer::popScope() {
+    if (scopeMarks.empty()) return;
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    for (size_t i = mark; i < availableLog.size(); i++) {
+        available.erase(availableLog[i]);
     }
+    availableLog.resize(mark);
+}
 
-    cout << "=================================================\n" << endl;
+void SemanticAnalyzer::replaceCode(const QuadList& newCode) {
+    code.assign(newCode.begin(), newCode.end());
+    nextquad = 100 + code.size();
 }
 
-void SemanticAnalyzer::printQuadruple() {
-    cout << "\n==================== Ԫʽ ====================" << endl;
-    cout << setw(8) << "" << setw(10) << "op" << setw(10) << "arg1"
-        << setw(10) << "arg2" << setw(10) << "result" << endl;
-    cout << "----------------------------------------------------" << endl;
-
-    for (size_t i = 0; i < code.size(); i++) {
-        cout << setw(8) << (100 + i)
-            << setw(10) << code[i].op
-            << setw(10) << code[i].arg1
-            << setw(10) << code[i].arg2
-            << setw(10) << code[i].result << endl;
+void SemanticAnalyzer::backpatch(int addr, int target) {
+    if (addr >= 100 && addr - 100 < (int)code.size()) {
+        code[addr - 100].result = to_string(target);
     }
+}
 
-    cout << "====================================================\n" << endl;
+int SemanticAnalyzer::merge(int p1, int p2) {
+    if (p1 == -1) return p2;
+    if (p2 == -1) return p1;
+    return p1;  // 简化处理
 }
+
 void SemanticAnalyzer::removeLastQuad() {
-    if (!code.empty()) {
+    if (nextquad <= 100) return;
+    if ((int)code.size() == nextquad - 100) {
         code.pop_back();
-        nextquad--;
     }
-}
\ No newline at end of file
+    nextquad--;
+}
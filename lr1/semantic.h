@@ -1,30 +1,78 @@
-#pragma once
-#ifndef SEMANTIC_H
-#define SEMANTIC_H
-
-#include "common.h"
-
-class SemanticAnalyzer {
-private:
-    vector<Quadruple> code;     // ַ
-    int nextquad;               // һַָ
-    int tempCount;              // ʱ
-
-public:
-    SemanticAnalyzer();
-    //  SemanticAnalyzer һУ
-    void removeLastQuad();  // ɾһָgoto
-    void reset();
-    string newtemp();
-    int emit(const string& op, const string& arg1, const string& arg2, const string& result);
-    void backpatch(int addr, int target);
-    int merge(int p1, int p2);
-
-    int getNextQuad() const { return nextquad; }
-    const vector<Quadruple>& getCode() const { return code; }
-
-    void printCode();
-    void printQuadruple();  // ӡԪʽʽ
-};
-
-#endif
+#pragma once
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include "common.h"
+#include <unordered_map>
+
+// 值编号表的键：(运算符, 左操作数值编号, 右操作数值编号)
+struct ExprKey {
+    char op;
+    int left;
+    int right;
+
+    bool operator==(const ExprKey& other) const {
+        return op == other.op && left == other.left && right == other.right;
+    }
+};
+
+struct ExprKeyHash {
+    size_t operator()(const ExprKey& k) const {
+        return ((size_t)k.left * 1000003u) ^ ((size_t)k.right * 31u) ^ (size_t)k.op;
+    }
+};
+
+class SemanticAnalyzer {
+private:
+    pmr::memory_resource* memory;   // 以下各表的存储来源
+    QuadList code;              // 三地址码序列
+    int nextquad;               // 下一条指令地址
+    int tempCount;              // 已分配过的临时变量数（同时活跃的最大个数）
+    pmr::vector<int> freeTemps;     // 已释放可复用的临时变量编号，按栈方式使用
+    pmr::vector<int> tempRefs;      // 各临时变量尚未消耗的引用数，公共子表达式复用时大于1
+
+    // 值编号：变量每被赋值一次得到新的编号，常量按字面值编号
+    pmr::unordered_map<string, int> valueNumber;
+    int nextValueNumber;
+    int numberOf(const string& place);
+
+    // 已计算的表达式 -> 保存结果的临时变量及其当时的值编号（编号变了说明已被改写）
+    struct Available {
+        string place;
+        int number;
+    };
+    pmr::unordered_map<ExprKey, Available, ExprKeyHash> available;
+    pmr::vector<ExprKey> availableLog;  // 按插入顺序记录，用于退出作用域时删除
+    pmr::vector<size_t> scopeMarks;
+    int cseHits;
+
+    bool emitEnabled;           // 发现错误后不再生成代码
+
+public:
+    explicit SemanticAnalyzer(pmr::memory_resource* mr = pmr::get_default_resource());
+    // 在 SemanticAnalyzer 类中添加一行：
+    void removeLastQuad();  // 删除最后一条指令（用于消除冗余goto）
+    void reset();   // 各表重新从memory分配，旧存储全部放弃，之后内存区可以整体释放
+    string newtemp();
+    void freetemp(const string& place);     // 表达式临时变量只使用一次，用完即释放
+    static bool isTempName(const string& s);    // 是否为newtemp生成的名字 t1, t2, ...
+    int emit(const string& op, const string& arg1, const string& arg2, const string& result);
+
+    // 生成 t = a op b 并返回t；若同一表达式已计算且未被改写，直接返回原来的临时变量
+    string emitExpr(const string& op, const string& a, const string& b);
+
+    // 分支的作用域：进入分支前push，离开时pop，分支内算出的表达式在分支外不可用
+    void pushScope();
+    void popScope();
+    void backpatch(int addr, int target);
+    int merge(int p1, int p2);
+
+    int getNextQuad() const { return nextquad; }
+    int getTempCount() const { return tempCount; }
+    int getCseHits() const { return cseHits; }
+    void disableEmit() { emitEnabled = false; }
+    const QuadList& getCode() const { return code; }
+    void replaceCode(const QuadList& newCode);    // 用优化后的代码替换
+};
+
+#endif
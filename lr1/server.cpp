@@ -0,0 +1,333 @@
+#include "server.h"
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static const size_t MAX_FRAME = 64 * 1024 * 1024;
+
+CompileServer::Connection::~Connection() {
+    if (fd < 0) {
+        fflush(out);    // 标准输入输出不关闭
+        return;
+    }
+    fclose(in);
+    fclose(out);
+}
+
+CompileServer::CompileServer(int threads, bool optimizeCode, size_t batchLimit)
+    : pool(threads), optimize(optimizeCode), maxBatch(max(batchLimit, (size_t)1)), readers(0), stopping(false),
+    listenFd(-1), nextReaderId(0), latencyNext(0), requests(0), batches(0) {}
+
+bool CompileServer::init() {
+    return parser.init();
+}
+
+bool CompileServer::readFrame(FILE* in, string& command, string& body) {
+    string header;
+    int ch;
+    while ((ch = getc(in)) != EOF && ch != '\n') {
+        if (header.size() > 64) return false;
+        header += (char)ch;
+    }
+    if (ch == EOF) return false;
+
+    istringstream hs(header);
+    long long length = -1;
+    if (!(hs >> command >> length) || length < 0 || (size_t)length > MAX_FRAME) return false;
+
+    body.resize(length);
+    return length == 0 || fread(&body[0], 1, length, in) == (size_t)length;
+}
+
+bool CompileServer::writeFrame(Connection& conn, bool ok, const string& body) {
+    lock_guard<mutex> guard(conn.writeLock);
+    fprintf(conn.out, "%s %zu\n", ok ? "ok" : "error", body.size());
+    fwrite(body.data(), 1, body.size(), conn.out);
+    return fflush(conn.out) == 0;
+}
+
+// 读取结束后连接从connections中移除：队列中尚未答复的请求仍持有它，
+// 最后一个响应写出后连接随即关闭，长期运行时不会积累文件描述符
+void CompileServer::readLoop(shared_ptr<Connection> conn, int id) {
+    string command, body;
+    while (readFrame(conn->in, command, body)) {
+        Request r;
+        r.conn = conn;
+        r.command = command;
+        r.source.swap(body);
+        r.arrived = chrono::steady_clock::now();
+        r.ok = false;
+
+        lock_guard<mutex> guard(lock);
+        queue.push_back(move(r));
+        ready.notify_one();
+        if (command == "shutdown") break;
+    }
+
+    lock_guard<mutex> guard(lock);
+    connections.erase(remove(connections.begin(), connections.end(), conn), connections.end());
+    if (id >= 0) finishedReaders.push_back(id);
+    readers--;
+    ready.notify_one();
+}
+
+// 线程在放入finishedReaders后只剩解锁和返回，join很快完成
+void CompileServer::joinFinishedReaders() {
+    vector<thread> done;
+    {
+        lock_guard<mutex> guard(lock);
+        for (int id : finishedReaders) {
+            auto it = readerThreads.find(id);
+            if (it == readerThreads.end()) continue;
+            done.push_back(move(it->second));
+            readerThreads.erase(it);
+        }
+        finishedReaders.clear();
+    }
+    for (thread& t : done) t.join();
+}
+
+void CompileServer::compileRequest(Request& r) {
+    unique_ptr<Compiler> c;
+    {
+        lock_guard<mutex> guard(compilersLock);
+        if (!idle.empty()) {
+            c = move(idle.back());
+            idle.pop_back();
+        }
+    }
+    if (!c) {
+        c.reset(new Compiler(&parser));
+        c->setQuiet(true);
+        c->setOptimize(optimize);
+    }
+
+    r.ok = c->compile(r.source);
+    ostringstream out;
+    if (r.ok) {
+        int addr = 100;
+        for (const Quadruple& q : c->getCode()) {
+            out << addr++ << '\t' << q.op << '\t' << q.arg1 << '\t' << q.arg2 << '\t' << q.result << '\n';
+        }
+    }
+    else if (c->getDiagnostics().empty()) {
+        out << "0\t编译失败\n";
+    }
+    else {
+        for (const Diagnostic& d : c->getDiagnostics()) {
+            out << d.line << '\t' << d.message << '\n';
+        }
+    }
+    r.response = out.str();
+
+    lock_guard<mutex> guard(compilersLock);
+    idle.push_back(move(c));
+}
+
+// 取nearest-rank百分位
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+string CompileServer::statsJson() {
+    vector<double> sorted = latencies;
+    sort(sorted.begin(), sorted.end());
+
+    ostringstream out;
+    out << "{\"requests\": " << requests
+        << ", \"batches\": " << batches
+        << ", \"threads\": " << pool.size()
+        << ", \"latency_ms\": {\"p50\": " << percentile(sorted, 50)
+        << ", \"p90\": " << percentile(sorted, 90)
+        << ", \"p99\": " << percentile(sorted, 99)
+        << ", \"max\": " << (sorted.empty() ? 0 : sorted.back()) << "}}\n";
+    return out.str();
+}
+
+void CompileServer::closeAll() {
+#ifndef _WIN32
+    lock_guard<mutex> guard(lock);
+    if (listenFd >= 0) shutdown(listenFd, SHUT_RDWR);     // accept随即失败返回
+    for (const shared_ptr<Connection>& conn : connections) {
+        // 只关闭读方向：阻塞在读取上的线程随即返回，队列中尚未答复的请求仍能写回响应
+        shutdown(conn->fd, SHUT_RD);
+    }
+#endif
+}
+
+void CompileServer::dispatch() {
+    vector<Request> batch;
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            ready.wait(guard, [this] { return !queue.empty() || readers == 0; });
+            if (queue.empty()) break;
+
+            batch.clear();
+            while (!queue.empty() && batch.size() < maxBatch) {
+                batch.push_back(move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        // 同一批的编译请求并行处理
+        vector<size_t> compiles;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (batch[i].command == "compile") compiles.push_back(i);
+        }
+        pool.parallelFor(compiles.size(), [&](size_t k) { compileRequest(batch[compiles[k]]); });
+        batches++;
+
+        bool shutdownRequested = false;
+        for (Request& r : batch) {
+            if (r.command == "stats") {
+                r.ok = true;
+                r.response = statsJson();
+            }
+            else if (r.command == "shutdown") {
+                r.ok = true;
+                shutdownRequested = true;
+            }
+            else if (r.command != "compile") {
+                r.response = "未知命令：" + r.command + "\n";
+            }
+            writeFrame(*r.conn, r.ok, r.response);
+
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - r.arrived;
+            requests++;
+            if (latencies.size() < LATENCY_WINDOW) {
+                latencies.push_back(elapsed.count());
+            }
+            else {
+                latencies[latencyNext] = elapsed.count();
+                latencyNext = (latencyNext + 1) % LATENCY_WINDOW;
+            }
+        }
+
+        if (shutdownRequested) {
+            {
+                lock_guard<mutex> guard(lock);
+                stopping = true;
+            }
+            closeAll();
+        }
+    }
+}
+
+int CompileServer::serveStdio() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    shared_ptr<Connection> conn(new Connection(stdin, stdout, -1));
+    readers = 1;
+    thread reader(&CompileServer::readLoop, this, conn, -1);
+    dispatch();
+    reader.join();
+
+    cerr << "编译服务结束：" << statsJson();
+    return 0;
+}
+
+#ifndef _WIN32
+int CompileServer::serveSocket(const string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cerr << "套接字路径过长：" << path << endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listener < 0 || ::bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+        cerr << "无法在 " << path << " 上监听" << endl;
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+    listenFd = listener;
+
+    // 客户端提前断开时写入会触发SIGPIPE，忽略后由写入失败处理
+    signal(SIGPIPE, SIG_IGN);
+    cerr << "编译服务已启动：" << path << endl;
+
+    readers = 1;    // 监听线程
+    thread acceptor([&] {
+        while (true) {
+            int fd = accept(listener, nullptr, nullptr);
+            joinFinishedReaders();
+            if (fd < 0) {
+                int e = errno;
+                {
+                    lock_guard<mutex> guard(lock);
+                    if (stopping) break;
+                }
+                // 被信号打断、客户端在accept前断开属于暂时性错误；描述符或内存不足时稍候再试
+                if (e == EINTR || e == ECONNABORTED || e == EPROTO) continue;
+                if (e == EMFILE || e == ENFILE || e == ENOBUFS || e == ENOMEM) {
+                    this_thread::sleep_for(chrono::milliseconds(10));
+                    continue;
+                }
+                cerr << "accept失败：" << strerror(e) << endl;
+                break;
+            }
+
+            FILE* in = fdopen(fd, "rb");
+            int writeFd = dup(fd);
+            FILE* out = writeFd >= 0 ? fdopen(writeFd, "wb") : nullptr;
+            if (in == nullptr || out == nullptr) {
+                // 描述符不足：放弃这个连接，继续服务其他客户端
+                if (out != nullptr) fclose(out);
+                else if (writeFd >= 0) close(writeFd);
+                if (in != nullptr) fclose(in);
+                else close(fd);
+                continue;
+            }
+
+            lock_guard<mutex> guard(lock);
+            if (stopping) {
+                fclose(in);
+                fclose(out);
+                break;
+            }
+            shared_ptr<Connection> conn(new Connection(in, out, fd));
+            connections.push_back(conn);
+            readers++;
+            int id = nextReaderId++;
+            readerThreads[id] = thread(&CompileServer::readLoop, this, conn, id);
+        }
+        lock_guard<mutex> guard(lock);
+        readers--;
+        ready.notify_one();
+    });
+
+    dispatch();
+
+    acceptor.join();
+    for (auto& t : readerThreads) t.second.join();
+    readerThreads.clear();
+    finishedReaders.clear();
+    connections.clear();
+    listenFd = -1;
+    close(listener);
+    unlink(path.c_str());
+
+    cerr << "编译服务结束：" << statsJson();
+    return 0;
+}
+#endif
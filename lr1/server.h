@@ -0,0 +1,99 @@
+#pragma once
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "common.h"
+#include "compiler.h"
+#include "thread_pool.h"
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+
+// ==================== 编译服务 ====================
+// 分析表只构造一次，之后常驻接收编译请求。请求和响应都是帧：
+//   请求   "<命令> <长度>\n" + 长度个字节
+//   响应   "<ok|error> <长度>\n" + 长度个字节
+// 命令：
+//   compile  正文为源程序；成功时每行一条四元式 "地址\t op\t arg1\t arg2\t result"，
+//            失败时每行一条诊断 "行号\t 信息"
+//   stats    返回请求数、批次数和最近LATENCY_WINDOW个请求的延迟百分位（JSON）
+//   shutdown 处理完已收到的请求后退出
+// 各连接的请求放入同一个队列，分派线程每次取出全部待处理的请求（至多maxBatch个）
+// 作为一批交给线程池并行编译，再按到达顺序写回响应
+class CompileServer {
+private:
+    struct Connection {
+        FILE* in;
+        FILE* out;
+        int fd;             // 套接字，标准输入输出时为-1
+        mutex writeLock;
+
+        Connection(FILE* i, FILE* o, int f) : in(i), out(o), fd(f) {}
+        ~Connection();
+    };
+
+    struct Request {
+        shared_ptr<Connection> conn;
+        string command;
+        string source;
+        chrono::steady_clock::time_point arrived;
+        bool ok;
+        string response;
+    };
+
+    LR1Parser parser;       // 所有编译器共享，构造后只读
+    ThreadPool pool;
+    bool optimize;
+    size_t maxBatch;
+
+    mutex lock;
+    condition_variable ready;
+    deque<Request> queue;
+    int readers;            // 仍在读取请求的连接数（套接字模式下监听线程也算一个）
+    bool stopping;
+    int listenFd;           // 监听套接字，标准输入输出模式为-1
+    vector<shared_ptr<Connection>> connections;     // 仍在读取的连接，收到shutdown时关闭
+
+    // 套接字模式下各连接的读取线程；读取结束的线程把编号放入finishedReaders，
+    // 由监听线程在下次accept前回收，不必等到服务结束
+    map<int, thread> readerThreads;
+    vector<int> finishedReaders;
+    int nextReaderId;
+
+    // 空闲的编译器，每个任务借用一个，用完归还
+    mutex compilersLock;
+    vector<unique_ptr<Compiler>> idle;
+
+    // 以下只由分派线程访问
+    // 最近LATENCY_WINDOW个请求从到达到写回响应的毫秒数，循环覆盖，常驻运行时内存不随请求数增长
+    static const size_t LATENCY_WINDOW = 10000;
+    vector<double> latencies;
+    size_t latencyNext;         // 窗口满后下一个被覆盖的位置
+    long long requests;
+    long long batches;
+
+    void readLoop(shared_ptr<Connection> conn, int id);
+    void joinFinishedReaders();
+    void dispatch();
+    void compileRequest(Request& r);
+    string statsJson();
+    void closeAll();
+    static bool readFrame(FILE* in, string& command, string& body);
+    static bool writeFrame(Connection& conn, bool ok, const string& body);
+
+public:
+    explicit CompileServer(int threads = 0, bool optimizeCode = false, size_t batchLimit = 64);
+
+    LR1Parser& getParser() { return parser; }
+    bool init();            // 构造分析表
+
+    int serveStdio();       // 从标准输入读请求，响应写到标准输出，直到输入结束
+#ifndef _WIN32
+    int serveSocket(const string& path);    // 在Unix域套接字上监听，直到收到shutdown
+#endif
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "source_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceFile::SourceFile() : data(""), size(0), mapping(nullptr) {}
+
+SourceFile::~SourceFile() {
+    release();
+}
+
+SourceFile::SourceFile(SourceFile&& other) noexcept : data(""), size(0), mapping(nullptr) {
+    *this = move(other);
+}
+
+SourceFile& SourceFile::operator=(SourceFile&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    bool buffered = other.mapping == nullptr;
+    buffer = move(other.buffer);
+    mapping = other.mapping;
+    size = other.size;
+    data = buffered ? buffer.data() : other.data;
+    other.mapping = nullptr;
+    other.data = "";
+    other.size = 0;
+    return *this;
+}
+
+void SourceFile::release() {
+#ifndef _WIN32
+    if (mapping != nullptr) munmap(mapping, size);
+#endif
+    mapping = nullptr;
+    buffer.clear();
+    data = "";
+    size = 0;
+}
+
+bool SourceFile::map(const string& path, string& error) {
+    release();
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "无法打开文件：" + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        error = "无法读取文件：" + path;
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p != MAP_FAILED) {
+        mapping = p;
+        data = (const char*)p;
+        size = st.st_size;
+        return true;
+    }
+    // 映射失败（例如管道或特殊文件）时改为读入
+#endif
+    return read(path, error);
+}
+
+bool SourceFile::read(const string& path, string& error) {
+    release();
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in.is_open()) {
+        error = "无法打开文件：" + path;
+        return false;
+    }
+    streamoff length = in.tellg();
+    if (length < 0) {
+        error = "无法读取文件：" + path;
+        return false;
+    }
+    buffer.resize((size_t)length);
+    in.seekg(0);
+    if (length > 0 && !in.read(&buffer[0], length)) {
+        buffer.clear();
+        error = "无法读取文件：" + path;
+        return false;
+    }
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+}
+
+FilePrefetcher::FilePrefetcher(const vector<string>& files, size_t maxAhead)
+    : paths(files), depth(max(maxAhead, (size_t)1)), loaded(0), stopping(false) {
+    reader = thread(&FilePrefetcher::readLoop, this);
+}
+
+FilePrefetcher::~FilePrefetcher() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    reader.join();
+}
+
+void FilePrefetcher::readLoop() {
+    for (size_t i = 0; i < paths.size(); i++) {
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [this] { return stopping || ready.size() < depth; });
+            if (stopping) return;
+        }
+
+        // 读文件时不持有锁
+        Item item;
+        item.path = paths[i];
+        item.ok = item.file.read(item.path, item.error);
+
+        lock_guard<mutex> guard(lock);
+        ready.push_back(move(item));
+        loaded++;
+        changed.notify_all();
+    }
+}
+
+bool FilePrefetcher::next(Item& item) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return !ready.empty() || loaded == paths.size(); });
+    if (ready.empty()) return false;
+    item = move(ready.front());
+    ready.pop_front();
+    changed.notify_all();
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include "common.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// ==================== 源文件 ====================
+// 整个文件一次载入，保留换行（单词的行号依赖它），内容以string_view交给词法分析器
+class SourceFile {
+private:
+    const char* data;
+    size_t size;
+    void* mapping;      // mmap的地址，读入缓冲区时为nullptr
+    string buffer;
+
+    void release();
+
+public:
+    SourceFile();
+    ~SourceFile();
+    SourceFile(SourceFile&& other) noexcept;
+    SourceFile& operator=(SourceFile&& other) noexcept;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    // 只读映射文件，按需调页；不支持mmap的平台退回read
+    bool map(const string& path, string& error);
+    // 按文件大小一次读入，返回时数据已在内存中（用于预读）
+    bool read(const string& path, string& error);
+
+    string_view text() const { return string_view(data, size); }
+};
+
+// ==================== 预读 ====================
+// 批量编译一组文件时，由读取线程提前载入后面的至多depth个文件，与编译重叠
+class FilePrefetcher {
+public:
+    struct Item {
+        string path;
+        SourceFile file;
+        bool ok;
+        string error;
+    };
+
+private:
+    vector<string> paths;
+    size_t depth;
+    deque<Item> ready;
+    size_t loaded;          // 已交给ready的文件数
+    bool stopping;
+    mutex lock;
+    condition_variable changed;
+    thread reader;
+
+    void readLoop();
+
+public:
+    explicit FilePrefetcher(const vector<string>& files, size_t maxAhead = 4);
+    ~FilePrefetcher();
+
+    // 按顺序取下一个文件，尚未读完时等待；全部取完返回false
+    bool next(Item& item);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "stats.h"
+#include "output.h"
+#include <cstdio>
+
+void writeStatsJson(ostream& out, const CompileStats& stats, const vector<string>& ruleNames) {
+    const TableStats& t = stats.table;
+
+    out << "{\n";
+    out << "  \"success\": " << (stats.success ? "true" : "false") << ",\n";
+    out << "  \"errors\": " << stats.errors << ",\n";
+    out << "  \"phases_ms\": {"
+        << "\"lex\": " << stats.lexMs
+        << ", \"table\": " << stats.tableMs
+        << ", \"parse\": " << stats.parseMs
+        << ", \"optimize\": " << stats.optimizeMs
+        << ", \"execute\": " << stats.executeMs
+        << ", \"native_build\": " << stats.nativeMs
+        << ", \"batch\": " << stats.batchMs
+        << ", \"total\": " << stats.totalMs << "},\n";
+    out << "  \"tokens\": " << stats.tokens << ",\n";
+    out << "  \"shifts\": " << stats.shifts << ",\n";
+
+    long long steps = stats.shifts;
+    for (long long n : stats.reductions) steps += n;
+    out << "  \"parse_steps\": " << steps << ",\n";
+    out << "  \"steps_per_token\": " << (stats.tokens > 0 ? (double)steps / stats.tokens : 0.0) << ",\n";
+
+    out << "  \"reductions\": [";
+    bool first = true;
+    for (size_t i = 0; i < stats.reductions.size(); i++) {
+        if (stats.reductions[i] == 0) continue;
+        if (!first) out << ", ";
+        out << "{\"prod\": " << i;
+        if (i < ruleNames.size()) out << ", \"rule\": \"" << jsonEscape(ruleNames[i]) << "\"";
+        out << ", \"count\": " << stats.reductions[i] << "}";
+        first = false;
+    }
+    out << "],\n";
+
+    out << "  \"max_stack_depth\": " << stats.maxStackDepth << ",\n";
+    out << "  \"quads\": " << stats.quads << ",\n";
+    if (stats.optimized) out << "  \"optimized_quads\": " << stats.optimizedQuads << ",\n";
+    if (stats.executeRuns > 0) out << "  \"execute_runs\": " << stats.executeRuns << ",\n";
+    if (stats.batchRows > 0) out << "  \"batch_rows\": " << stats.batchRows << ",\n";
+    if (stats.nativeMismatches >= 0) out << "  \"native_mismatches\": " << stats.nativeMismatches << ",\n";
+    out << "  \"temps\": " << stats.temps << ",\n";
+    out << "  \"cse_hits\": " << stats.cseHits << ",\n";
+    out << "  \"arena_bytes\": " << stats.arenaBytes << ",\n";
+    out << "  \"arena_overflows\": " << stats.arenaOverflows << ",\n";
+
+    out << "  \"table\": {\n";
+    out << "    \"phases_ms\": {"
+        << "\"grammar\": " << t.grammarMs
+        << ", \"first_follow\": " << t.firstFollowMs
+        << ", \"states\": " << t.statesMs
+        << ", \"table\": " << t.tableMs << "},\n";
+    out << "    \"closure_calls\": " << t.closureCalls << ",\n";
+    out << "    \"closure_cache_hits\": " << t.closureHits << ",\n";
+    out << "    \"closure_cache_hit_rate\": "
+        << (t.closureCalls > 0 ? (double)t.closureHits / t.closureCalls : 0.0) << ",\n";
+    out << "    \"items_created\": " << t.itemsCreated << ",\n";
+    out << "    \"states\": " << t.states << ",\n";
+    out << "    \"action_entries\": " << t.actionEntries << ",\n";
+    out << "    \"goto_entries\": " << t.gotoEntries << ",\n";
+    out << "    \"build_threads\": " << t.buildThreads << ",\n";
+    out << "    \"conflicts\": {\"shift_reduce\": " << t.shiftReduceConflicts
+        << ", \"reduce_reduce\": " << t.reduceReduceConflicts
+        << ", \"resolved_by_precedence\": " << t.precedenceResolved << "},\n";
+    if (t.renumbered) {
+        out << "    \"renumber\": {\"hot_lines_before\": " << t.hotLinesBefore
+            << ", \"hot_lines_after\": " << t.hotLinesAfter << "},\n";
+    }
+    if (t.unitChainEntries >= 0) out << "    \"unit_chain_entries\": " << t.unitChainEntries << ",\n";
+    out << "    \"from_cache\": " << (t.fromCache ? "true" : "false") << "\n";
+    out << "  }\n";
+    out << "}\n";
+}
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+#include <chrono>
+
+// ==================== 计时器 ====================
+struct Stopwatch {
+    chrono::steady_clock::time_point start;
+
+    Stopwatch() : start(chrono::steady_clock::now()) {}
+    void restart() { start = chrono::steady_clock::now(); }
+
+    // 返回自start以来经过的毫秒数
+    double elapsedMs() const {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+};
+
+// ==================== 分析表构造统计 ====================
+struct TableStats {
+    double grammarMs;           // 初始化文法耗时
+    double firstFollowMs;       // 计算FIRST/FOLLOW集耗时
+    double statesMs;            // 构造项目集族耗时
+    double tableMs;             // 构造分析表耗时
+    long long closureCalls;     // closure调用次数
+    long long closureHits;      // 闭包缓存命中次数
+    long long itemsCreated;     // 新建LR(1)项目数
+    int states;                 // 状态数
+    int actionEntries;          // ACTION表项数
+    int gotoEntries;            // GOTO表项数
+    int buildThreads;           // 构造项目集族使用的线程数
+    int shiftReduceConflicts;   // 按默认规则（移进）处理的移进/归约冲突
+    int reduceReduceConflicts;  // 按默认规则（编号小的产生式）处理的归约/归约冲突
+    int precedenceResolved;     // 按优先级和结合性消解的冲突
+    bool fromCache;             // 分析表是否从缓存加载
+    bool renumbered;            // 是否按剖析数据重排了状态和列
+    int hotLinesBefore;         // 重排前覆盖99%表访问的缓存行数
+    int hotLinesAfter;          // 重排后覆盖99%表访问的缓存行数
+    int unitChainEntries;       // 与普通GOTO不同的链式GOTO表项数，-1表示未启用单产生式短路
+
+    TableStats() : grammarMs(0), firstFollowMs(0), statesMs(0), tableMs(0),
+        closureCalls(0), closureHits(0), itemsCreated(0), states(0), actionEntries(0), gotoEntries(0),
+        buildThreads(1), shiftReduceConflicts(0), reduceReduceConflicts(0), precedenceResolved(0), fromCache(false), renumbered(false), hotLinesBefore(0), hotLinesAfter(0),
+        unitChainEntries(-1) {}
+};
+
+// ==================== 单次编译统计 ====================
+struct CompileStats {
+    bool success;
+    int errors;                 // 词法和语法错误数
+    double lexMs;               // 词法分析耗时
+    double tableMs;             // 构造分析表耗时
+    double parseMs;             // 语法分析+语义翻译耗时
+    double optimizeMs;          // 中间代码优化耗时
+    double executeMs;           // 字节码执行耗时（全部重复次数）
+    double totalMs;             // 总耗时
+    int tokens;                 // 单词数（不含结束符#）
+    long long shifts;           // 移进次数
+    vector<long long> reductions;   // 按产生式编号统计的归约次数
+    int maxStackDepth;          // 分析栈最大深度
+    int quads;                  // 生成的四元式数
+    bool optimized;             // 是否执行了优化
+    int optimizedQuads;         // 优化后的四元式数
+    int executeRuns;            // 字节码执行次数，0表示未执行
+    double nativeMs;            // 生成并编译本地代码的耗时
+    int nativeMismatches;       // 翻译确认中与虚拟机不一致的次数，-1表示未生成本地代码
+    double batchMs;             // 列式批量执行耗时
+    long long batchRows;        // 批量执行的记录数
+    int temps;                  // 分配的临时变量数
+    int cseHits;                // 公共子表达式复用次数
+    size_t arenaBytes;          // 本次编译从内存区分配的字节数
+    int arenaOverflows;         // 超出内存区初始缓冲区或块池的次数（0表示没有用到全局分配器）
+    TableStats table;
+
+    CompileStats() : success(false), errors(0), lexMs(0), tableMs(0), parseMs(0), optimizeMs(0), executeMs(0), totalMs(0),
+        tokens(0), shifts(0), maxStackDepth(0), quads(0), optimized(false), optimizedQuads(0), executeRuns(0),
+        nativeMs(0), nativeMismatches(-1),
+        batchMs(0), batchRows(0), temps(0), cseHits(0), arenaBytes(0), arenaOverflows(0) {}
+
+    void reset() { *this = CompileStats(); }
+};
+
+// 以JSON格式输出统计信息，ruleNames[i]为第i个产生式的文本
+void writeStatsJson(ostream& out, const CompileStats& stats, const vector<string>& ruleNames);
+
+#endif
@@ -0,0 +1,109 @@
+#include "thread_pool.h"
+#include "alloc_stats.h"
+
+ThreadPool::ThreadPool(int threads) : job(nullptr), remaining(0), generation(0), stopping(false) {
+    if (threads <= 0) {
+        threads = (int)thread::hardware_concurrency();
+    }
+    // 单线程时不创建工作线程，parallelFor直接在调用线程执行
+    if (threads <= 1) return;
+
+    for (int i = 0; i < threads; i++) {
+        queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& t : workers) {
+        t.join();
+    }
+}
+
+// 先取自己队尾的任务，取不到再依次从其他队列队头窃取
+bool ThreadPool::popOrSteal(int id, size_t& item) {
+    {
+        WorkQueue& own = *queues[id];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.items.empty()) {
+            item = own.items.back();
+            own.items.pop_back();
+            return true;
+        }
+    }
+
+    int n = (int)queues.size();
+    for (int k = 1; k < n; k++) {
+        WorkQueue& victim = *queues[(id + k) % n];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.items.empty()) {
+            item = victim.items.front();
+            victim.items.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int id) {
+    size_t seen = 0;
+
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        size_t item;
+        while (popOrSteal(id, item)) {
+            (*job.load())(item);
+            if (remaining.fetch_sub(1) == 1) {
+                lock_guard<mutex> guard(lock);
+                finished.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& task) {
+    if (count == 0) return;
+
+    if (workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+
+#ifdef LR1_ALLOC_STATS
+    // 工作线程按调用者所处的阶段统计分配
+    AllocPhase phase = AllocScope::current();
+    function<void(size_t)> scoped = [&task, phase](size_t i) {
+        AllocScope scope(phase);
+        task(i);
+    };
+    job.store(&scoped);
+#else
+    job.store(&task);
+#endif
+    remaining.store(count);
+
+    // 轮转分配到各队列，负载不均时由窃取平衡
+    for (size_t i = 0; i < count; i++) {
+        WorkQueue& q = *queues[i % queues.size()];
+        lock_guard<mutex> guard(q.lock);
+        q.items.push_back(i);
+    }
+
+    unique_lock<mutex> guard(lock);
+    generation++;
+    wake.notify_all();
+    finished.wait(guard, [&] { return remaining.load() == 0; });
+}
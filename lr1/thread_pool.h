@@ -0,0 +1,47 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "common.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <functional>
+
+// ==================== 工作窃取线程池 ====================
+// 每个工作线程有自己的双端队列，从队尾取任务，空闲时从其他线程队头窃取
+class ThreadPool {
+private:
+    struct WorkQueue {
+        mutex lock;
+        deque<size_t> items;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<WorkQueue>> queues;
+
+    mutex lock;
+    condition_variable wake;        // 通知工作线程有新任务
+    condition_variable finished;    // 通知调用者任务全部完成
+    atomic<const function<void(size_t)>*> job;
+    atomic<size_t> remaining;
+    size_t generation;
+    bool stopping;
+
+    void workerLoop(int id);
+    bool popOrSteal(int id, size_t& item);
+
+public:
+    explicit ThreadPool(int threads = 0);   // 0 表示使用全部硬件线程
+    ~ThreadPool();
+
+    int size() const { return workers.empty() ? 1 : (int)workers.size(); }
+
+    // 并行执行 task(0) ... task(count-1)，全部完成后返回
+    void parallelFor(size_t count, const function<void(size_t)>& task);
+};
+
+#endif
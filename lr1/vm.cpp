@@ -0,0 +1,299 @@
+#include "vm.h"
+#include "semantic.h"
+
+static const char* const OPCODE_NAMES[OP_COUNT] = {
+    "halt", "mov", "add", "sub", "mul", "div", "jmp",
+    "jlt", "jle", "jgt", "jge", "jeq", "jne",
+    "blt", "ble", "bgt", "bge", "beq", "bne"
+};
+
+const char* VM::opcodeName(uint8_t op) {
+    return op < OP_COUNT ? OPCODE_NAMES[op] : "?";
+}
+
+const char* VM::statusText(VMStatus s) {
+    switch (s) {
+    case VM_OK: return "正常结束";
+    case VM_DIV_ZERO: return "除数为零";
+    case VM_BAD_OPCODE: return "非法指令";
+    }
+    return "未知错误";
+}
+
+// 关系运算符在 OP_JLT..OP_JNE / OP_BLT..OP_BNE 中的偏移
+static int relopIndex(const string& rop) {
+    static const char* const ROPS[] = { "<", "<=", ">", ">=", "==", "!=" };
+    for (int i = 0; i < 6; i++) {
+        if (rop == ROPS[i]) return i;
+    }
+    return -1;
+}
+
+static bool isNumberLiteral(const string& s) {
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+    if (i >= s.size()) return false;
+    for (; i < s.size(); i++) {
+        if (!isdigit((unsigned char)s[i])) return false;
+    }
+    return true;
+}
+
+bool Bytecode::lower(const QuadList& code, Bytecode& out, string& error, int base) {
+    out = Bytecode();
+    int n = code.size();
+
+    // 第一遍：收集变量名，程序变量在前、临时变量在后，各自按首次出现的顺序
+    vector<string> vars, temps;
+    set<string> seen;
+    auto addName = [&](const string& s) {
+        if (s.empty() || s == "_" || isNumberLiteral(s) || seen.count(s)) return;
+        seen.insert(s);
+        (SemanticAnalyzer::isTempName(s) ? temps : vars).push_back(s);
+    };
+    for (const Quadruple& q : code) {
+        addName(q.arg1);
+        addName(q.arg2);
+        if (q.op.empty() || q.op[0] != 'j') addName(q.result);
+    }
+
+    out.names = vars;
+    out.names.insert(out.names.end(), temps.begin(), temps.end());
+    out.varSlots = vars.size();
+
+    map<string, int32_t> slotOf;
+    for (size_t i = 0; i < out.names.size(); i++) {
+        slotOf[out.names[i]] = i;
+    }
+
+    map<int64_t, int32_t> constSlot;
+    auto operand = [&](const string& s) -> int32_t {
+        if (!isNumberLiteral(s)) return slotOf[s];
+        int64_t v = strtoll(s.c_str(), nullptr, 10);
+        auto it = constSlot.find(v);
+        if (it != constSlot.end()) return it->second;
+        int32_t slot = out.names.size() + out.constants.size();
+        out.constants.push_back(v);
+        constSlot[v] = slot;
+        return slot;
+    };
+
+    // 指令下标与四元式下标一一对应，末尾追加halt作为“跳到程序结束”的目标
+    auto target = [&](const Quadruple& q, int32_t& t) {
+        t = atoi(q.result.c_str()) - base;
+        if (t < 0 || t > n) {
+            error = "跳转目标越界：" + q.result;
+            return false;
+        }
+        return true;
+    };
+
+    for (int i = 0; i < n; i++) {
+        const Quadruple& q = code[i];
+        uint8_t op;
+        int32_t a = 0, b = 0, c = 0, d = 0;
+
+        if (q.op == "=") {
+            op = OP_MOV;
+            a = operand(q.arg1);
+            c = slotOf[q.result];
+        }
+        else if (q.op == "+" || q.op == "-" || q.op == "*" || q.op == "/") {
+            op = q.op == "+" ? OP_ADD : q.op == "-" ? OP_SUB : q.op == "*" ? OP_MUL : OP_DIV;
+            a = operand(q.arg1);
+            b = operand(q.arg2);
+            c = slotOf[q.result];
+        }
+        else if (q.op == "j") {
+            op = OP_JMP;
+            if (!target(q, c)) return false;
+        }
+        else if (q.op.size() > 1 && q.op[0] == 'j' && relopIndex(q.op.substr(1)) >= 0) {
+            int rel = relopIndex(q.op.substr(1));
+            a = operand(q.arg1);
+            b = operand(q.arg2);
+            if (!target(q, c)) return false;
+
+            // 条件翻译总是生成 j<rop> 紧跟 j，融合为一条双目标分支；
+            // 后面的 j 保留，它仍可能是其他跳转的目标
+            if (i + 1 < n && code[i + 1].op == "j") {
+                op = OP_BLT + rel;
+                if (!target(code[i + 1], d)) return false;
+            }
+            else {
+                op = OP_JLT + rel;
+            }
+        }
+        else {
+            error = "无法翻译的四元式操作：" + q.op;
+            return false;
+        }
+
+        out.ops.push_back(op);
+        out.a.push_back(a);
+        out.b.push_back(b);
+        out.c.push_back(c);
+        out.d.push_back(d);
+    }
+
+    out.ops.push_back(OP_HALT);
+    out.a.push_back(0);
+    out.b.push_back(0);
+    out.c.push_back(0);
+    out.d.push_back(0);
+    return true;
+}
+
+ProgramView Bytecode::view() const {
+    ProgramView v;
+    v.ops = ops.data();
+    v.a = a.data();
+    v.b = b.data();
+    v.c = c.data();
+    v.d = d.data();
+    v.count = ops.size();
+    v.namedSlots = names.size();
+    v.varSlots = varSlots;
+    v.constants = constants.data();
+    v.constCount = constants.size();
+    return v;
+}
+
+void Bytecode::disassemble(ostream& out) const {
+    auto slot = [&](int32_t s) {
+        if (s < (int32_t)names.size()) return names[s];
+        return "#" + to_string(constants[s - names.size()]);
+    };
+
+    out << "\n字节码（" << ops.size() << " 条指令，" << names.size() << " 个变量槽位，"
+        << constants.size() << " 个常量）：" << endl;
+    for (size_t i = 0; i < ops.size(); i++) {
+        out << "  " << setw(4) << i << "  " << left << setw(5) << VM::opcodeName(ops[i]) << right;
+        uint8_t op = ops[i];
+        if (op == OP_MOV) {
+            out << slot(c[i]) << ", " << slot(a[i]);
+        }
+        else if (op >= OP_ADD && op <= OP_DIV) {
+            out << slot(c[i]) << ", " << slot(a[i]) << ", " << slot(b[i]);
+        }
+        else if (op == OP_JMP) {
+            out << "@" << c[i];
+        }
+        else if (op >= OP_JLT && op <= OP_JNE) {
+            out << slot(a[i]) << ", " << slot(b[i]) << ", @" << c[i];
+        }
+        else if (op >= OP_BLT && op <= OP_BNE) {
+            out << slot(a[i]) << ", " << slot(b[i]) << ", @" << c[i] << ", @" << d[i];
+        }
+        out << endl;
+    }
+}
+
+VMStatus VM::execute(const ProgramView& p, int64_t* r) {
+    for (int32_t k = 0; k < p.constCount; k++) {
+        r[p.namedSlots + k] = p.constants[k];
+    }
+
+    const uint8_t* ops = p.ops;
+    const int32_t* A = p.a;
+    const int32_t* B = p.b;
+    const int32_t* C = p.c;
+    const int32_t* D = p.d;
+    int32_t pc = 0;
+
+#ifdef LR1_VM_THREADED
+    // 分派表按操作码索引，顺序必须与Opcode一致
+    static void* const labels[OP_COUNT] = {
+        &&L_OP_HALT, &&L_OP_MOV, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV, &&L_OP_JMP,
+        &&L_OP_JLT, &&L_OP_JLE, &&L_OP_JGT, &&L_OP_JGE, &&L_OP_JEQ, &&L_OP_JNE,
+        &&L_OP_BLT, &&L_OP_BLE, &&L_OP_BGT, &&L_OP_BGE, &&L_OP_BEQ, &&L_OP_BNE
+    };
+#define VM_DISPATCH()   goto *labels[ops[pc]]
+#define VM_CASE(op)     L_##op
+    VM_DISPATCH();
+    {
+#else
+#define VM_DISPATCH()   goto dispatch
+#define VM_CASE(op)     case op
+dispatch:
+    switch (ops[pc]) {
+#endif
+
+    VM_CASE(OP_HALT):
+        return VM_OK;
+
+    VM_CASE(OP_MOV):
+        r[C[pc]] = r[A[pc]];
+        pc++;
+        VM_DISPATCH();
+
+    VM_CASE(OP_ADD):
+        r[C[pc]] = wrapAdd(r[A[pc]], r[B[pc]]);
+        pc++;
+        VM_DISPATCH();
+
+    VM_CASE(OP_SUB):
+        r[C[pc]] = wrapSub(r[A[pc]], r[B[pc]]);
+        pc++;
+        VM_DISPATCH();
+
+    VM_CASE(OP_MUL):
+        r[C[pc]] = wrapMul(r[A[pc]], r[B[pc]]);
+        pc++;
+        VM_DISPATCH();
+
+    VM_CASE(OP_DIV): {
+        int64_t y = r[B[pc]];
+        if (y == 0 || (y == -1 && r[A[pc]] == INT64_MIN)) return VM_DIV_ZERO;
+        r[C[pc]] = r[A[pc]] / y;
+        pc++;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(OP_JMP):
+        pc = C[pc];
+        VM_DISPATCH();
+
+#define VM_COMPARE(J, BR, cmp)                                          \
+    VM_CASE(J):                                                         \
+        pc = (r[A[pc]] cmp r[B[pc]]) ? C[pc] : pc + 1;                  \
+        VM_DISPATCH();                                                  \
+    VM_CASE(BR):                                                        \
+        pc = (r[A[pc]] cmp r[B[pc]]) ? C[pc] : D[pc];                   \
+        VM_DISPATCH();
+
+    VM_COMPARE(OP_JLT, OP_BLT, <)
+    VM_COMPARE(OP_JLE, OP_BLE, <=)
+    VM_COMPARE(OP_JGT, OP_BGT, >)
+    VM_COMPARE(OP_JGE, OP_BGE, >=)
+    VM_COMPARE(OP_JEQ, OP_BEQ, ==)
+    VM_COMPARE(OP_JNE, OP_BNE, !=)
+
+#undef VM_COMPARE
+
+#ifndef LR1_VM_THREADED
+    default:
+        return VM_BAD_OPCODE;
+#endif
+    }
+
+#undef VM_DISPATCH
+#undef VM_CASE
+    return VM_BAD_OPCODE;
+}
+
+VMStatus VM::run(const ProgramView& p, const vector<string>& names,
+    const map<string, int64_t>& input, map<string, int64_t>& output) {
+    vector<int64_t> regs(p.slotCount(), 0);
+    for (int32_t i = 0; i < p.varSlots; i++) {
+        auto it = input.find(names[i]);
+        if (it != input.end()) regs[i] = it->second;
+    }
+
+    VMStatus status = execute(p, regs.data());
+
+    output.clear();
+    for (int32_t i = 0; i < p.varSlots; i++) {
+        output[names[i]] = regs[i];
+    }
+    return status;
+}
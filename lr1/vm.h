@@ -0,0 +1,99 @@
+#pragma once
+#ifndef VM_H
+#define VM_H
+
+#include "common.h"
+#include <cstdint>
+
+// GCC/Clang支持标签地址（computed goto），用于线索化分派；定义LR1_VM_SWITCH可改用switch分派
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(LR1_VM_SWITCH)
+#define LR1_VM_THREADED 1
+#endif
+
+// 有符号溢出按二进制补码回绕，避免未定义行为；优化器的常量折叠也用这几个函数，与执行结果一致
+inline int64_t wrapAdd(int64_t x, int64_t y) { return (int64_t)((uint64_t)x + (uint64_t)y); }
+inline int64_t wrapSub(int64_t x, int64_t y) { return (int64_t)((uint64_t)x - (uint64_t)y); }
+inline int64_t wrapMul(int64_t x, int64_t y) { return (int64_t)((uint64_t)x * (uint64_t)y); }
+
+// ==================== 字节码指令 ====================
+// 操作数均为寄存器槽位：程序变量、临时变量、常量依次排列
+enum Opcode : uint8_t {
+    OP_HALT,                // 结束
+    OP_MOV,                 // r[c] = r[a]
+    OP_ADD,                 // r[c] = r[a] + r[b]
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_JMP,                 // goto c
+    OP_JLT,                 // if r[a] < r[b] goto c
+    OP_JLE,
+    OP_JGT,
+    OP_JGE,
+    OP_JEQ,
+    OP_JNE,
+    OP_BLT,                 // if r[a] < r[b] goto c else goto d（j<rop> + j 融合）
+    OP_BLE,
+    OP_BGT,
+    OP_BGE,
+    OP_BEQ,
+    OP_BNE,
+    OP_COUNT
+};
+
+// 执行结果
+enum VMStatus {
+    VM_OK = 0,
+    VM_DIV_ZERO = 1,        // 除数为零
+    VM_BAD_OPCODE = 2
+};
+
+// ==================== 程序视图 ====================
+// 只引用外部存储的各列，执行时不做任何拷贝（字节码对象或映射的文件均可）
+struct ProgramView {
+    const uint8_t* ops;
+    const int32_t* a;
+    const int32_t* b;
+    const int32_t* c;
+    const int32_t* d;
+    int32_t count;          // 指令数（最后一条为OP_HALT）
+    int32_t namedSlots;     // 变量与临时变量槽位数
+    int32_t varSlots;       // 其中程序变量槽位数（槽位0..varSlots-1）
+    const int64_t* constants;   // 常量池，占用槽位namedSlots..namedSlots+constCount-1
+    int32_t constCount;
+
+    int slotCount() const { return namedSlots + constCount; }
+};
+
+// ==================== 字节码程序 ====================
+struct Bytecode {
+    vector<uint8_t> ops;
+    vector<int32_t> a, b, c, d;     // 操作数按列存放
+    vector<string> names;           // 槽位对应的变量名，程序变量在前、临时变量在后
+    int varSlots;
+    vector<int64_t> constants;
+
+    Bytecode() : varSlots(0) {}
+
+    // 把四元式翻译为字节码，跳转目标换算为指令下标，首条四元式地址为base
+    static bool lower(const QuadList& code, Bytecode& out, string& error, int base = 100);
+
+    ProgramView view() const;
+    void disassemble(ostream& out) const;
+};
+
+// ==================== 虚拟机 ====================
+class VM {
+public:
+    // 在寄存器组r上执行程序，r至少有view.slotCount()个元素；常量由此函数装入。
+    // 不检查操作码和操作数，程序须由Bytecode::lower生成或已经过校验
+    static VMStatus execute(const ProgramView& p, int64_t* r);
+
+    // 以变量绑定为输入执行，返回结束时各程序变量的值；未绑定的变量初值为0
+    static VMStatus run(const ProgramView& p, const vector<string>& names,
+        const map<string, int64_t>& input, map<string, int64_t>& output);
+
+    static const char* opcodeName(uint8_t op);
+    static const char* statusText(VMStatus s);
+};
+
+#endif